@@ -0,0 +1,16 @@
+// Atlas frame animations. The table has an entry per frame, and tiles set to the first frame of an
+// animation play through it using the frame time - keep in step with TileAnimations::resolve()
+#include "frame.glsl"
+
+// Per atlas frame: first frame, frame count, milliseconds per frame
+uniform usamplerBuffer animations;
+
+uint animatedFrame(uint frame)
+{
+	uvec4 animation = texelFetch(animations, int(frame));
+
+	if (animation.y < 2u)
+		return frame;
+
+	return animation.x + (uint(time * 1000.0) / animation.z) % animation.y;
+}
\ No newline at end of file
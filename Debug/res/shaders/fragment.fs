@@ -6,7 +6,13 @@ in vec2 texCoord;
 
 uniform sampler2D texture1;
 
+#include "lighting.glsl"
+
 void main()
 {
     FragColor = texture(texture1, texCoord);
+
+#ifdef LIGHTING
+    FragColor.rgb *= lighting();
+#endif
 } 
\ No newline at end of file
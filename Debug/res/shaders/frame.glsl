@@ -0,0 +1,12 @@
+// Per-frame data shared by every program - mirrors FrameUniforms, keep the two in step
+layout (std140) uniform Frame
+{
+	mat4 viewProjection;
+	vec2 camera;
+	vec2 viewport;
+	float time;
+	// Light level where no light reaches, 1.0 with lighting off
+	float ambient;
+	// Pixels per world unit
+	float zoom;
+};
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+#ifdef TINT
+in vec4 tint;
+#endif
+flat in uint layer;
+
+uniform sampler2DArray tiles;
+
+#include "lighting.glsl"
+
+void main()
+{
+    FragColor = texture(tiles, vec3(texCoord, float(layer)));
+
+#ifdef TINT
+    FragColor *= tint;
+#endif
+
+#ifdef LIGHTING
+    FragColor.rgb *= lighting();
+#endif
+}
\ No newline at end of file
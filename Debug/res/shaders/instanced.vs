@@ -0,0 +1,38 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+// per instance
+layout (location = 2) in vec2 aTilePos;
+layout (location = 3) in uint aFrame;
+layout (location = 4) in vec4 aTint;
+
+out vec2 texCoord;
+#ifdef TINT
+out vec4 tint;
+#endif
+flat out uint layer;
+
+#include "frame.glsl"
+#include "animation.glsl"
+
+const float TILE_SIZE = 64.0;
+
+void main()
+{
+	// Every atlas frame is its own layer of the tile array
+	texCoord = aTexCoord;
+
+#ifdef ANIMATED
+	layer = animatedFrame(aFrame);
+#else
+	layer = aFrame;
+#endif
+
+#ifdef TINT
+	tint = aTint;
+#endif
+
+    gl_Position = viewProjection * vec4(aPos.xy + aTilePos * TILE_SIZE, aPos.z, 1.0);
+}
\ No newline at end of file
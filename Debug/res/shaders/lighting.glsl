@@ -0,0 +1,41 @@
+// Tiled forward lighting. The lights are culled into LIGHT_TILE_SIZE pixel squares of the screen on the CPU,
+// so each fragment only walks the lights whose radius reaches its own square.
+#include "frame.glsl"
+
+// Two texels per light: position.xy, radius, intensity - then colour.rgb
+uniform samplerBuffer lights;
+// Per screen tile: first entry in lightIndices and the number of lights
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+
+// Keep in step with LIGHT_TILE_SIZE in stdafx.h
+const int LIGHT_TILE_SIZE = 32;
+
+vec3 lighting()
+{
+	// The camera sits in the centre of the screen, zoom pixels per world unit
+	vec2 world = camera + (gl_FragCoord.xy - viewport * 0.5) / zoom;
+
+	int tilesX = (int(viewport.x) + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	ivec2 tile = ivec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE;
+
+	uvec2 range = texelFetch(lightGrid, tile.y * tilesX + tile.x).xy;
+
+	vec3 light = vec3(ambient);
+
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+
+		vec4 shape = texelFetch(lights, index * 2);
+		vec3 colour = texelFetch(lights, index * 2 + 1).rgb;
+
+		// Smooth falloff reaching zero at the radius
+		vec2 delta = (world - shape.xy) / shape.z;
+		float falloff = max(1.0 - dot(delta, delta), 0.0);
+
+		light += colour * shape.w * falloff * falloff;
+	}
+
+	return light;
+}
\ No newline at end of file
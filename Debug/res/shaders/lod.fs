@@ -0,0 +1,16 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+// One pre-baked square of the map pyramid
+uniform sampler2D node;
+
+#include "lighting.glsl"
+
+void main()
+{
+    FragColor = texture(node, texCoord);
+    FragColor.rgb *= lighting();
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Node quad generated from gl_VertexID, drawn as a 4 vertex triangle strip
+uniform vec2 origin;
+uniform vec2 size;
+
+out vec2 texCoord;
+
+#include "frame.glsl"
+
+void main()
+{
+	texCoord = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));
+
+    gl_Position = viewProjection * vec4(origin + texCoord * size, 0.0, 1.0);
+}
\ No newline at end of file
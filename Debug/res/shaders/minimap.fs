@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+// One texel per dungeon tile
+uniform sampler2D map;
+
+// Tile the player is standing on
+uniform vec2 marker;
+
+void main()
+{
+	vec2 tile = floor(texCoord * vec2(textureSize(map, 0)));
+
+    FragColor = tile == marker ? vec4(1.0) : texture(map, texCoord);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+// Corner quad generated from gl_VertexID, drawn as a 4 vertex triangle strip
+uniform vec2 rectMin;
+uniform vec2 rectMax;
+
+out vec2 texCoord;
+
+void main()
+{
+	texCoord = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));
+
+	gl_Position = vec4(mix(rectMin, rectMax, texCoord), 0.0, 1.0);
+}
\ No newline at end of file
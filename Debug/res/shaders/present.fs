@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// The software renderer's frame, one texel per pixel
+uniform sampler2D image;
+
+void main()
+{
+	FragColor = texelFetch(image, ivec2(gl_FragCoord.xy), 0);
+}
\ No newline at end of file
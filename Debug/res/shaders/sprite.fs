@@ -0,0 +1,16 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+in vec4 colour;
+
+uniform sampler2D texture1;
+
+#include "lighting.glsl"
+
+void main()
+{
+    FragColor = texture(texture1, texCoord) * colour;
+    FragColor.rgb *= lighting();
+}
\ No newline at end of file
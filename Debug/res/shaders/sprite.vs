@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColour;
+
+out vec2 texCoord;
+out vec4 colour;
+
+#include "frame.glsl"
+
+void main()
+{
+	texCoord = aTexCoord;
+	colour = aColour;
+
+    gl_Position = viewProjection * vec4(aPos, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2DArray tiles;
+uniform usampler2D tileMap;
+
+#include "lighting.glsl"
+#include "animation.glsl"
+
+uniform vec2 mapSize;
+
+const float TILE_SIZE = 64.0;
+
+void main()
+{
+	// The camera sits in the centre of the screen, zoom pixels per world unit
+	vec2 world = camera + (gl_FragCoord.xy - viewport * 0.5) / zoom;
+
+	// Tiles are centred on their position, so shift by half a tile
+	vec2 tilePos = (world + TILE_SIZE * 0.5) / TILE_SIZE;
+	vec2 tile = floor(tilePos);
+
+	if (tile.x < 0.0 || tile.y < 0.0 || tile.x >= mapSize.x || tile.y >= mapSize.y)
+		discard;
+
+	// Every atlas frame is its own layer of the tile array
+	uint frame = animatedFrame(texelFetch(tileMap, ivec2(tile), 0).r);
+
+	// Gradients from the continuous coordinate, so mip selection doesn't jump at tile edges
+    FragColor = textureGrad(tiles, vec3(fract(tilePos), float(frame)), dFdx(tilePos), dFdy(tilePos));
+    FragColor.rgb *= lighting();
+}
\ No newline at end of file
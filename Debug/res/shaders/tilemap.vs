@@ -0,0 +1,9 @@
+#version 330 core
+
+// Full-screen triangle generated from gl_VertexID - no vertex buffers needed
+void main()
+{
+	vec2 pos = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+
+	gl_Position = vec4(pos, 0.0, 1.0);
+}
\ No newline at end of file
@@ -5,11 +5,14 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 texCoord;
 
-uniform mat4 transform;
+#include "frame.glsl"
+
+// World position of the tile's centre
+uniform vec2 offset;
 uniform mat4 frame;
 
 void main()
 {
 	texCoord = (frame * vec4(aTexCoord, 0.0, 1.0)).xy;
-    gl_Position = transform * vec4(aPos, 1.0);
+    gl_Position = viewProjection * vec4(aPos.xy + offset, aPos.z, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+
+#include "CacheFile.h"
+
+#include <filesystem>
+
+namespace fs = std::experimental::filesystem;
+
+std::uint64_t fnv1a(const void* data, size_t size, std::uint64_t h)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= FNV_PRIME;
+	}
+
+	return h;
+}
+
+bool writeFileAtomically(const std::string& path, const void* header, size_t headerSize, const void* data, size_t size)
+{
+	std::string temporary = path + ".tmp";
+
+	FILE* file;
+
+	if (fopen_s(&file, temporary.c_str(), "wb") != 0)
+		return false;
+
+	bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(data, 1, size, file) == size;
+
+	fclose(file);
+
+	std::error_code error;
+
+	if (written)
+		fs::rename(temporary, path, error);
+
+	if (!written || error)
+	{
+		fs::remove(temporary, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <cstdint>
+#include <string>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// 64-bit FNV-1a of the bytes, continuing from h so several pieces can be hashed as one
+std::uint64_t fnv1a(const void* data, size_t size, std::uint64_t h = FNV_OFFSET_BASIS);
+
+// Writes header then data under a temporary name and renames it into place, so a run that dies half way
+// never leaves a valid-looking cache entry. The directory has to exist already.
+bool writeFileAtomically(const std::string& path, const void* header, size_t headerSize, const void* data, size_t size);
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+
+#include "ChunkRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <math.h>
+
+ChunkRenderer::ChunkRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders)
+{
+	this->quadVBO = quadVBO;
+	this->quadEBO = quadEBO;
+
+	dungeon = NULL;
+
+	chunksX = 0;
+	chunksY = 0;
+
+	totalFrames = 1;
+
+	this->shaders = shaders;
+}
+
+ChunkRenderer::~ChunkRenderer()
+{
+	destroy();
+}
+
+void ChunkRenderer::destroy()
+{
+	for (TileChunk& chunk : chunks)
+	{
+		glDeleteBuffers(1, &chunk.instanceVBO);
+		glDeleteVertexArrays(1, &chunk.VAO);
+	}
+
+	chunks.clear();
+	dirtyChunks.clear();
+}
+
+void ChunkRenderer::createChunk(TileChunk& chunk)
+{
+	chunk.instanceCount = 0;
+	chunk.dirty = true;
+
+	glGenVertexArrays(1, &chunk.VAO);
+	glGenBuffers(1, &chunk.instanceVBO);
+
+	glBindVertexArray(chunk.VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+
+	// position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// texture coord attribute
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.instanceVBO);
+
+	// Storage for a full chunk, never resized
+	glBufferData(GL_ARRAY_BUFFER, CHUNK_SIZE * CHUNK_SIZE * sizeof(TileInstance), NULL, GL_STATIC_DRAW);
+
+	setupInstanceAttributes(chunk.instanceVBO);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ChunkRenderer::bakeChunk(int cx, int cy, RenderCommandList* commands)
+{
+	TileChunk& chunk = chunks[(cy * chunksX) + cx];
+
+	instances.clear();
+
+	int endX = std::min((cx + 1) * CHUNK_SIZE, dungeon->getWidth());
+	int endY = std::min((cy + 1) * CHUNK_SIZE, dungeon->getHeight());
+
+	for (int y = cy * CHUNK_SIZE; y < endY; y++)
+	{
+		for (int x = cx * CHUNK_SIZE; x < endX; x++)
+		{
+			const Tile& t = dungeon->getTile(x, y);
+
+			instances.push_back({ glm::vec2((float)t.posX, (float)t.posY), t.id % totalFrames, t.colour });
+		}
+	}
+
+	if (commands != NULL)
+	{
+		commands->bufferSubData(GL_ARRAY_BUFFER, chunk.instanceVBO, 0, instances.size() * sizeof(TileInstance), instances.data());
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.instanceVBO);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(TileInstance), instances.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	chunk.instanceCount = (int)instances.size();
+	chunk.dirty = false;
+}
+
+void ChunkRenderer::build(Dungeon* dungeon, int totalFrames)
+{
+	destroy();
+
+	this->dungeon = dungeon;
+	this->totalFrames = totalFrames > 0 ? totalFrames : 1;
+
+	chunksX = (dungeon->getWidth() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	chunksY = (dungeon->getHeight() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	chunks.resize(chunksX * chunksY);
+
+	for (int cy = 0; cy < chunksY; cy++)
+	{
+		for (int cx = 0; cx < chunksX; cx++)
+		{
+			createChunk(chunks[(cy * chunksX) + cx]);
+
+			bakeChunk(cx, cy, NULL);
+		}
+	}
+
+#ifdef DEBUG_ON
+	printf("Baked %d x %d chunks of %d tiles...\n", chunksX, chunksY, CHUNK_SIZE * CHUNK_SIZE);
+#endif
+}
+
+void ChunkRenderer::update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed)
+{
+	if (dungeon == NULL)
+		return;
+
+	for (glm::ivec2 t : changed)
+	{
+		int index = ((t.y / CHUNK_SIZE) * chunksX) + (t.x / CHUNK_SIZE);
+
+		if (!chunks[index].dirty)
+		{
+			chunks[index].dirty = true;
+			dirtyChunks.push_back(index);
+		}
+	}
+
+	for (int index : dirtyChunks)
+	{
+		bakeChunk(index % chunksX, index / chunksX, commands);
+	}
+
+	dirtyChunks.clear();
+}
+
+int ChunkRenderer::render(RenderCommandList* commands, const Box2d& visible, unsigned int tileArray, unsigned int features)
+{
+	if (chunks.empty())
+		return 0;
+
+	// Chunks of the corner cells - floored, since the cells can be off the map on either side
+	glm::ivec2 first(glm::floor(glm::vec2(Dungeon::worldToCell(glm::vec2(visible.left, visible.bottom))) / (float)CHUNK_SIZE));
+	glm::ivec2 last(glm::floor(glm::vec2(Dungeon::worldToCell(glm::vec2(visible.right, visible.top))) / (float)CHUNK_SIZE));
+
+	int firstX = std::max(first.x, 0);
+	int lastX = std::min(last.x, chunksX - 1);
+	int firstY = std::max(first.y, 0);
+	int lastY = std::min(last.y, chunksY - 1);
+
+	int draws = 0;
+
+	commands->useProgram(shaders->get(features)->getId());
+
+	commands->bindTexture(0, GL_TEXTURE_2D_ARRAY, tileArray);
+
+	for (int cy = firstY; cy <= lastY; cy++)
+	{
+		for (int cx = firstX; cx <= lastX; cx++)
+		{
+			const TileChunk& chunk = chunks[(cy * chunksX) + cx];
+
+			if (chunk.instanceCount == 0)
+				continue;
+
+			commands->bindVertexArray(chunk.VAO);
+
+			commands->drawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, chunk.instanceCount);
+
+			draws++;
+		}
+	}
+
+	return draws;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderVariants.h"
+#include "TileRenderer.h"
+
+// A CHUNK_SIZE x CHUNK_SIZE block of tiles whose instance data lives on the GPU
+struct TileChunk {
+
+	unsigned int VAO;
+	unsigned int instanceVBO;
+
+	int instanceCount;
+
+	bool dirty;
+};
+
+// Draws the dungeon from static per-chunk buffers, baked once and only rebuilt when a tile changes.
+// Scrolling only changes the view uniform and which chunks are drawn.
+class ChunkRenderer
+{
+private:
+
+	unsigned int quadVBO;
+	unsigned int quadEBO;
+
+	// Shared with the other instanced renderers
+	ShaderVariants* shaders;
+
+	Dungeon* dungeon;
+
+	std::vector<TileChunk> chunks;
+
+	int chunksX;
+	int chunksY;
+
+	int totalFrames;
+
+	// Indices of chunks waiting to be re-baked
+	std::vector<int> dirtyChunks;
+
+	// Scratch space for baking a single chunk
+	std::vector<TileInstance> instances;
+
+	void createChunk(TileChunk& chunk);
+	// Uploads straight away when commands is NULL, otherwise records the upload
+	void bakeChunk(int cx, int cy, RenderCommandList* commands);
+
+	ChunkRenderer() {}
+
+public:
+	ChunkRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders);
+	~ChunkRenderer();
+
+	// Bake every chunk of the dungeon - call again after regenerating it
+	void build(Dungeon* dungeon, int totalFrames);
+
+	// Re-bake every chunk containing one of the changed tiles
+	void update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed);
+
+	// Draws every chunk overlapping the box (in world units) with the variant for the ShaderFeature bits,
+	// returns the number of draw calls recorded
+	int render(RenderCommandList* commands, const Box2d& visible, unsigned int tileArray, unsigned int features);
+
+	void destroy();
+};
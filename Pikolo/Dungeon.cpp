@@ -3,6 +3,7 @@
 #include "Dungeon.h"
 #include "PerlinNoise.h"
 
+#include <algorithm>
 #include <math.h>
 
 int roomSize = DEFAULT_ROOM_SIZE;
@@ -10,6 +11,15 @@ int roomSize = DEFAULT_ROOM_SIZE;
 PerlinNoise _noise;
 std::vector<Tile> tiles;
 
+std::vector<glm::ivec2> changedTiles;
+
+// Sparse layers, bucketed by CHUNK_SIZE square so culling only visits the chunks in view. An empty
+// chunk costs one empty vector.
+std::vector<std::vector<LayerTile>> layerChunks[(int)TileLayer::COUNT];
+int layerChunksX = 0;
+
+unsigned int changedLayers = 0;
+
 std::vector<Tile> Dungeon::getTiles()
 {
 	return tiles;
@@ -72,31 +82,36 @@ bool checkCollision(float posX, float posY, int sx, int sy)
 	return false;
 }
 
-std::vector<Tile> Dungeon::getVisibleTiles(float camx, float camy)
+glm::ivec2 Dungeon::worldToCell(glm::vec2 world)
 {
-	std::vector<Tile> t;
+	// Tiles are centred on their position * TILE_SIZE, so shift by half a tile before dividing
+	return glm::ivec2(glm::floor((world + glm::vec2(TILE_SIZE / 2)) / (float)TILE_SIZE));
+}
 
-	int firstX = (int)std::floor((camx / 64.0)) - TILES_ON_SCREEN_X;
-	int firstY = (int)std::floor((camy / 64.0)) - TILES_ON_SCREEN_Y;
+TileRange Dungeon::getVisibleRange(const Box2d& visible)
+{
+	glm::ivec2 first = worldToCell(glm::vec2(visible.left, visible.bottom));
+	glm::ivec2 last = worldToCell(glm::vec2(visible.right, visible.top));
 
-	int x, y, z;
+	return { std::max(first.x, 0), std::min(last.x, getWidth() - 1), std::max(first.y, 0), std::min(last.y, getHeight() - 1) };
+}
 
-	for (int j = -1; j <= TILES_ON_SCREEN_Y * 2 + 2; j++)
-	{
-		for (int i = -1; i <= TILES_ON_SCREEN_X * 2 + 1; i++)
-		{
-			x = firstX + i;
-			y = firstY + j;
+void Dungeon::getVisibleTiles(const Box2d& visible, std::vector<Tile>& out)
+{
+	out.clear();
 
-			z = (y * roomSize) + x;
+	TileRange range = getVisibleRange(visible);
 
-			if (z >= 0 && z <= tiles.size() - 1) {
-				t.push_back(tiles[z]);
-			}
-		}
-	}
+	if (range.empty())
+		return;
 
-	return t;
+	// Clamping the columns keeps each span inside its own row, so nothing wraps in from the next one
+	for (int y = range.firstY; y <= range.lastY; y++)
+	{
+		const Tile* row = &tiles[(y * roomSize) + range.firstX];
+
+		out.insert(out.end(), row, row + (range.lastX - range.firstX + 1));
+	}
 }
 
 Dungeon::Dungeon(int size)
@@ -114,7 +129,149 @@ Dungeon Dungeon::generate()
 
 float Dungeon::getMaxDimension()
 {
-	return (roomSize - 1) * 64.0f;
+	return (roomSize - 1) * (float)TILE_SIZE;
+}
+
+int Dungeon::getWidth()
+{
+	return roomSize;
+}
+
+int Dungeon::getHeight()
+{
+	return roomSize - 1;
+}
+
+const Tile& Dungeon::getTile(int x, int y)
+{
+	return tiles[(y * roomSize) + x];
+}
+
+void Dungeon::setTileId(int x, int y, unsigned int id)
+{
+	if (x < 0 || y < 0 || x >= getWidth() || y >= getHeight())
+		return;
+
+	tiles[(y * roomSize) + x].id = id;
+
+	changedTiles.push_back(glm::ivec2(x, y));
+}
+
+std::vector<glm::ivec2> Dungeon::takeChangedTiles()
+{
+	std::vector<glm::ivec2> changed;
+
+	changed.swap(changedTiles);
+
+	return changed;
+}
+
+bool Dungeon::hasChangedTiles()
+{
+	return !changedTiles.empty() || changedLayers != 0;
+}
+
+static std::vector<LayerTile>& layerChunk(TileLayer layer, int x, int y)
+{
+	return layerChunks[(int)layer][((y / CHUNK_SIZE) * layerChunksX) + (x / CHUNK_SIZE)];
+}
+
+void Dungeon::setLayerTile(TileLayer layer, int x, int y, unsigned int id)
+{
+	if (layer == TileLayer::FLOOR)
+	{
+		setTileId(x, y, id);
+		return;
+	}
+
+	if (x < 0 || y < 0 || x >= getWidth() || y >= getHeight())
+		return;
+
+	std::vector<LayerTile>& chunk = layerChunk(layer, x, y);
+
+	auto found = std::find_if(chunk.begin(), chunk.end(), [x, y](const LayerTile& t) { return t.posX == x && t.posY == y; });
+
+	if (id == LAYER_EMPTY)
+	{
+		if (found == chunk.end())
+			return;
+
+		chunk.erase(found);
+	}
+	else if (found != chunk.end())
+	{
+		found->id = id;
+	}
+	else
+	{
+		chunk.push_back({ id, x, y });
+	}
+
+	changedLayers |= 1 << (int)layer;
+
+	changedTiles.push_back(glm::ivec2(x, y));
+}
+
+unsigned int Dungeon::getLayerTile(TileLayer layer, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= getWidth() || y >= getHeight())
+		return LAYER_EMPTY;
+
+	if (layer == TileLayer::FLOOR)
+		return getTile(x, y).id;
+
+	for (const LayerTile& t : layerChunk(layer, x, y))
+	{
+		if (t.posX == x && t.posY == y)
+			return t.id;
+	}
+
+	return LAYER_EMPTY;
+}
+
+void Dungeon::getVisibleLayerTiles(TileLayer layer, const Box2d& visible, std::vector<LayerTile>& out)
+{
+	if (layer == TileLayer::FLOOR || layerChunks[(int)layer].empty())
+		return;
+
+	TileRange range = getVisibleRange(visible);
+
+	if (range.empty())
+		return;
+
+	for (int cy = range.firstY / CHUNK_SIZE; cy <= range.lastY / CHUNK_SIZE; cy++)
+	{
+		for (int cx = range.firstX / CHUNK_SIZE; cx <= range.lastX / CHUNK_SIZE; cx++)
+		{
+			for (const LayerTile& t : layerChunks[(int)layer][(cy * layerChunksX) + cx])
+			{
+				if (t.posX >= range.firstX && t.posX <= range.lastX && t.posY >= range.firstY && t.posY <= range.lastY)
+					out.push_back(t);
+			}
+		}
+	}
+}
+
+size_t Dungeon::getLayerTileCount(TileLayer layer)
+{
+	if (layer == TileLayer::FLOOR)
+		return tiles.size();
+
+	size_t count = 0;
+
+	for (const std::vector<LayerTile>& chunk : layerChunks[(int)layer])
+		count += chunk.size();
+
+	return count;
+}
+
+unsigned int Dungeon::takeChangedLayers()
+{
+	unsigned int changed = changedLayers;
+
+	changedLayers = 0;
+
+	return changed;
 }
 
 Dungeon Dungeon::generate(int seed)
@@ -140,6 +297,36 @@ Dungeon Dungeon::generate(int seed)
 		}
 	}
 
+	layerChunksX = (getWidth() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	int layerChunksY = (getHeight() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	for (int layer = (int)TileLayer::WALLS; layer < (int)TileLayer::COUNT; layer++)
+	{
+		layerChunks[layer].assign(layerChunksX * layerChunksY, std::vector<LayerTile>());
+	}
+
+	// Walls round the edge and in clumps where the noise is high, with decals scattered on the floor and
+	// the odd overhead beam - most cells of every layer stay empty
+	for (int j = 0; j < getHeight(); j++)
+	{
+		for (int i = 0; i < getWidth(); i++)
+		{
+			double n = _noise.noise(i * 0.15, j * 0.15);
+
+			if (i == 0 || j == 0 || i == getWidth() - 1 || j == getHeight() - 1 || n > 0.45)
+				setLayerTile(TileLayer::WALLS, i, j, (i * 7) + (j * 13));
+			else if (_noise.noise(i * 0.9, j * 0.9, 0.5) > 0.5)
+				setLayerTile(TileLayer::DECALS, i, j, (i * 3) + (j * 5));
+
+			if (j % 12 == 6 && n < -0.2)
+				setLayerTile(TileLayer::OVERHEAD, i, j, i + j);
+		}
+	}
+
+	// Generating isn't an edit
+	changedTiles.clear();
+	changedLayers = 0;
+
 #ifdef DEBUG_ON
 	printf("Finished generating dungeon...<size=%d>\n", roomSize);
 #endif
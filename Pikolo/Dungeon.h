@@ -20,6 +20,36 @@ struct Tile {
 	}
 };
 
+// Map layers in draw order. The floor is the dense Tile grid, the others are sparse.
+enum class TileLayer
+{
+	FLOOR, WALLS, DECALS, OVERHEAD, COUNT
+};
+
+// Inclusive range of cells, empty when first > last on either axis
+struct TileRange {
+
+	int firstX;
+	int lastX;
+	int firstY;
+	int lastY;
+
+	bool empty() const { return firstX > lastX || firstY > lastY; }
+	int count() const { return empty() ? 0 : (lastX - firstX + 1) * (lastY - firstY + 1); }
+};
+
+// Marks an empty cell of a sparse layer
+#define LAYER_EMPTY 0xFFFFFFFF
+
+// An occupied cell of a sparse layer
+struct LayerTile {
+
+	unsigned int id;
+
+	int posX;
+	int posY;
+};
+
 class Dungeon
 {
 private:
@@ -30,7 +60,41 @@ public:
 	Dungeon(int size);
 
 	std::vector<Tile> getTiles();
-	std::vector<Tile> getVisibleTiles(float camx, float camy);
+
+	// The cell a point (in world units) falls in - not clamped, so it can be off the map
+	static glm::ivec2 worldToCell(glm::vec2 world);
+
+	// Cells overlapping the box (in world units), clamped to the map - works for any viewport size and zoom
+	TileRange getVisibleRange(const Box2d& visible);
+
+	// Replaces the contents of out with the tiles overlapping the box, a row span at a time. Reusing out
+	// between calls keeps its storage, so nothing is allocated once it has grown to the largest view.
+	void getVisibleTiles(const Box2d& visible, std::vector<Tile>& out);
+
+	const Tile& getTile(int x, int y);
+
+	// Changes the atlas frame of a single tile and records it for takeChangedTiles()
+	void setTileId(int x, int y, unsigned int id);
+
+	// Returns every cell changed on any layer since the last call, in tile coordinates
+	std::vector<glm::ivec2> takeChangedTiles();
+	bool hasChangedTiles();
+
+	// Sets a cell of any layer - LAYER_EMPTY clears a sparse cell
+	void setLayerTile(TileLayer layer, int x, int y, unsigned int id);
+	unsigned int getLayerTile(TileLayer layer, int x, int y);
+
+	// Appends the occupied cells of a sparse layer that overlap the box (in world units) to out. Only the
+	// chunks under the box are looked at, so the cost follows what's visible rather than the layer's size.
+	void getVisibleLayerTiles(TileLayer layer, const Box2d& visible, std::vector<LayerTile>& out);
+
+	size_t getLayerTileCount(TileLayer layer);
+
+	// Returns a bit per TileLayer changed since the last call
+	unsigned int takeChangedLayers();
+
+	int getWidth();
+	int getHeight();
 
 	Dungeon generate();
 	Dungeon generate(int seed);
@@ -0,0 +1,293 @@
+#include "stdafx.h"
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+
+const char* profileStageName(ProfileStage stage)
+{
+	switch (stage)
+	{
+	case ProfileStage::INPUT:
+		return "input";
+	case ProfileStage::UPDATE:
+		return "update";
+	case ProfileStage::CAMERA:
+		return "camera";
+	case ProfileStage::VISIBLE_TILES:
+		return "visible tiles";
+	case ProfileStage::RECORD:
+		return "record";
+	case ProfileStage::SUBMIT:
+		return "submit";
+	case ProfileStage::REPLAY:
+		return "replay";
+	case ProfileStage::SWAP:
+		return "swap";
+	default:
+		return "";
+	}
+}
+
+const char* gpuPassName(GpuPass pass)
+{
+	switch (pass)
+	{
+	case GpuPass::MAP:
+		return "map";
+	case GpuPass::SPRITES:
+		return "sprites";
+	case GpuPass::OVERHEAD:
+		return "overhead";
+	default:
+		return "";
+	}
+}
+
+FrameProfiler::FrameProfiler()
+{
+	frames.resize(PROFILER_HISTORY);
+
+	for (ProfiledFrame& f : frames)
+	{
+		f = {};
+		f.frame = -1;
+	}
+
+	glGenQueries(PROFILER_QUERY_FRAMES * (int)GpuPass::COUNT, &queries[0][0]);
+
+	resolvedFrame = -1;
+	droppedQueries = 0;
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	glDeleteQueries(PROFILER_QUERY_FRAMES * (int)GpuPass::COUNT, &queries[0][0]);
+}
+
+ProfiledFrame& FrameProfiler::slot(int frame)
+{
+	return frames[frame % PROFILER_HISTORY];
+}
+
+void FrameProfiler::beginFrame(int frame)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ProfiledFrame& f = slot(frame);
+
+	f = {};
+	f.frame = frame;
+
+	for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		f.gpu[i] = -1.0;
+}
+
+void FrameProfiler::addCpuTime(int frame, ProfileStage stage, double seconds)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ProfiledFrame& f = slot(frame);
+
+	if (f.frame == frame)
+		f.cpu[(int)stage] += seconds;
+}
+
+void FrameProfiler::beginGpu(RenderCommandList* commands, int frame, GpuPass pass)
+{
+	commands->beginQuery(GL_TIME_ELAPSED, queries[frame % PROFILER_QUERY_FRAMES][(int)pass]);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ProfiledFrame& f = slot(frame);
+
+	if (f.frame == frame)
+		f.gpuIssued |= 1 << (int)pass;
+}
+
+void FrameProfiler::endGpu(RenderCommandList* commands, int frame, GpuPass pass)
+{
+	commands->endQuery(GL_TIME_ELAPSED);
+}
+
+void FrameProfiler::resolve(int frame)
+{
+	if (frame < 0)
+		return;
+
+	unsigned int issued;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		issued = slot(frame).frame == frame ? slot(frame).gpuIssued : 0;
+	}
+
+	double times[(int)GpuPass::COUNT];
+	int dropped = 0;
+
+	for (int i = 0; i < (int)GpuPass::COUNT; i++)
+	{
+		times[i] = -1.0;
+
+		// Only queries that were actually begun exist yet
+		if ((issued & (1 << i)) == 0)
+			continue;
+
+		unsigned int query = queries[frame % PROFILER_QUERY_FRAMES][i];
+
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		// Rather than wait, lose the result - the query is reused next frame
+		if (!available)
+		{
+			dropped++;
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+		times[i] = elapsed / 1e9;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ProfiledFrame& f = slot(frame);
+
+	if (f.frame == frame)
+	{
+		for (int i = 0; i < (int)GpuPass::COUNT; i++)
+			f.gpu[i] = times[i];
+	}
+
+	resolvedFrame = std::max(resolvedFrame, frame);
+	droppedQueries += dropped;
+}
+
+bool FrameProfiler::getFrame(int frame, ProfiledFrame& out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (frame < 0 || slot(frame).frame != frame)
+		return false;
+
+	out = slot(frame);
+
+	return true;
+}
+
+ProfiledFrame FrameProfiler::getAverage(int count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ProfiledFrame average = {};
+	average.frame = resolvedFrame;
+
+	int gpuFrames[(int)GpuPass::COUNT] = {};
+
+	// Stay well clear of the slots the game thread is clearing
+	count = std::min(count, PROFILER_HISTORY / 2);
+
+	int cpuFrames = 0;
+
+	for (int frame = std::max(resolvedFrame - count + 1, 0); frame <= resolvedFrame; frame++)
+	{
+		const ProfiledFrame& f = slot(frame);
+
+		if (f.frame != frame)
+			continue;
+
+		for (int i = 0; i < (int)ProfileStage::COUNT; i++)
+			average.cpu[i] += f.cpu[i];
+
+		for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		{
+			if (f.gpu[i] >= 0.0)
+			{
+				average.gpu[i] += f.gpu[i];
+				gpuFrames[i]++;
+			}
+		}
+
+		cpuFrames++;
+	}
+
+	for (int i = 0; i < (int)ProfileStage::COUNT; i++)
+		average.cpu[i] /= std::max(cpuFrames, 1);
+
+	for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		average.gpu[i] = gpuFrames[i] > 0 ? average.gpu[i] / gpuFrames[i] : -1.0;
+
+	return average;
+}
+
+int FrameProfiler::getResolvedFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return resolvedFrame;
+}
+
+int FrameProfiler::getDroppedQueries()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return droppedQueries;
+}
+
+void FrameProfiler::writeCsv(FILE* file)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	fprintf(file, "frame");
+
+	for (int i = 0; i < (int)ProfileStage::COUNT; i++)
+		fprintf(file, ",%s", profileStageName((ProfileStage)i));
+
+	for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		fprintf(file, ",gpu %s", gpuPassName((GpuPass)i));
+
+	fprintf(file, "\n");
+
+	// Oldest first - only frames that are fully timed
+	for (int frame = std::max(resolvedFrame - PROFILER_HISTORY + 1, 0); frame <= resolvedFrame; frame++)
+	{
+		const ProfiledFrame& f = slot(frame);
+
+		if (f.frame != frame)
+			continue;
+
+		fprintf(file, "%d", frame);
+
+		for (int i = 0; i < (int)ProfileStage::COUNT; i++)
+			fprintf(file, ",%.4f", 1000.0 * f.cpu[i]);
+
+		// Blank where there's no result
+		for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		{
+			if (f.gpu[i] >= 0.0)
+				fprintf(file, ",%.4f", 1000.0 * f.gpu[i]);
+			else
+				fprintf(file, ",");
+		}
+
+		fprintf(file, "\n");
+	}
+}
+
+ProfileScope::ProfileScope(FrameProfiler* profiler, int frame, ProfileStage stage)
+{
+	this->profiler = profiler;
+	this->frame = frame;
+	this->stage = stage;
+
+	start = profiler != NULL ? glfwGetTime() : 0.0;
+}
+
+ProfileScope::~ProfileScope()
+{
+	if (profiler != NULL)
+		profiler->addCpuTime(frame, stage, glfwGetTime() - start);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+
+#include <mutex>
+#include <vector>
+
+// Frames of results kept in the ring
+#define PROFILER_HISTORY 240
+
+// Sets of timer queries cycled through - a frame's queries are read back once the next frame has been replayed
+#define PROFILER_QUERY_FRAMES 2
+
+// CPU stages, timed on whichever thread runs them
+enum class ProfileStage
+{
+	INPUT, UPDATE, CAMERA, VISIBLE_TILES, RECORD, SUBMIT, REPLAY, SWAP, COUNT
+};
+
+// GPU passes, timed with GL_TIME_ELAPSED queries - they can't nest, so passes mustn't overlap
+enum class GpuPass
+{
+	MAP, SPRITES, OVERHEAD, COUNT
+};
+
+const char* profileStageName(ProfileStage stage);
+const char* gpuPassName(GpuPass pass);
+
+// Seconds spent in each stage of one frame
+struct ProfiledFrame {
+
+	int frame;
+
+	double cpu[(int)ProfileStage::COUNT];
+
+	// Negative until the queries have been read back, or if the result wasn't ready in time
+	double gpu[(int)GpuPass::COUNT];
+
+	// Passes recorded this frame, one bit per GpuPass
+	unsigned int gpuIssued;
+};
+
+// Per-frame ring of CPU scope times and GPU pass times. The game thread records frame N while the render
+// thread replays frame N - 1, so both write into the ring by frame number. Queries are double buffered:
+// frame N's results are read after frame N + 1 has been replayed, so reading them never waits on the GPU.
+class FrameProfiler
+{
+private:
+
+	std::vector<ProfiledFrame> frames;
+
+	unsigned int queries[PROFILER_QUERY_FRAMES][(int)GpuPass::COUNT];
+
+	// Newest frame whose GPU times have been read back
+	int resolvedFrame;
+
+	// Results that weren't available when read back
+	int droppedQueries;
+
+	std::mutex mutex;
+
+	ProfiledFrame& slot(int frame);
+
+public:
+	// Creates the query objects, so must be called with the context current
+	FrameProfiler();
+	~FrameProfiler();
+
+	// Clears frame's slot before anything is timed in it
+	void beginFrame(int frame);
+
+	void addCpuTime(int frame, ProfileStage stage, double seconds);
+
+	// Record the start and end of a pass into frame's commands
+	void beginGpu(RenderCommandList* commands, int frame, GpuPass pass);
+	void endGpu(RenderCommandList* commands, int frame, GpuPass pass);
+
+	// Reads back frame's queries - must be called on the thread owning the context, after the frame has been replayed
+	void resolve(int frame);
+
+	// Copy of a frame still in the ring
+	bool getFrame(int frame, ProfiledFrame& out);
+
+	// Means over the last count frames with GPU results. GPU times only average frames that produced them.
+	ProfiledFrame getAverage(int count);
+
+	int getResolvedFrame();
+	int getDroppedQueries();
+
+	// Every frame still in the ring as CSV, in milliseconds
+	void writeCsv(FILE* file);
+};
+
+// Adds the time until it goes out of scope to a stage of frame
+class ProfileScope
+{
+private:
+
+	FrameProfiler* profiler;
+
+	int frame;
+	ProfileStage stage;
+
+	double start;
+
+public:
+	// profiler may be NULL, which times nothing
+	ProfileScope(FrameProfiler* profiler, int frame, ProfileStage stage);
+	~ProfileScope();
+};
@@ -0,0 +1,31 @@
+#include "stdafx.h"
+
+#include "FrameUniforms.h"
+
+#include <cstddef>
+
+static_assert(offsetof(FrameUniforms, camera) == 64 && offsetof(FrameUniforms, time) == 80 &&
+	offsetof(FrameUniforms, ambient) == 84 && offsetof(FrameUniforms, zoom) == 88 && sizeof(FrameUniforms) == 96,
+	"FrameUniforms must match the std140 layout of the Frame block");
+
+FrameUniformBuffer::FrameUniformBuffer()
+{
+	glGenBuffers(1, &buffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// The binding point is context state, so this only has to happen once
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, buffer);
+}
+
+FrameUniformBuffer::~FrameUniformBuffer()
+{
+	glDeleteBuffers(1, &buffer);
+}
+
+void FrameUniformBuffer::update(RenderCommandList* commands, const FrameUniforms& frame)
+{
+	commands->bufferSubData(GL_UNIFORM_BUFFER, buffer, 0, sizeof(FrameUniforms), &frame);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+
+// Mirrors the std140 layout of the Frame block declared in the shaders - keep the two in step
+struct FrameUniforms {
+
+	glm::mat4 viewProjection;
+
+	// World position at the centre of the screen, and the framebuffer size in pixels
+	glm::vec2 camera;
+	glm::vec2 viewport;
+
+	// Seconds since startup
+	float time;
+
+	// Light level where no light reaches - 1 leaves colours untouched
+	float ambient;
+
+	// Pixels per world unit - below 1 is zoomed out
+	float zoom;
+
+	// std140 rounds the block up to a multiple of 16 bytes
+	float padding;
+};
+
+// Per-frame data shared by every program through a single uniform buffer, uploaded once a frame
+// instead of being set on each program before every draw
+class FrameUniformBuffer
+{
+private:
+
+	unsigned int buffer;
+
+public:
+	// Creates the buffer and attaches it to FRAME_UNIFORM_BINDING
+	FrameUniformBuffer();
+	~FrameUniformBuffer();
+
+	void update(RenderCommandList* commands, const FrameUniforms& frame);
+};
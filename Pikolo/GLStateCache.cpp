@@ -0,0 +1,171 @@
+#include "stdafx.h"
+
+#include "GLStateCache.h"
+
+// Never a valid GL name or enum, so it differs from whatever is first set
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+	resetStats();
+}
+
+void GLStateCache::invalidate()
+{
+	program = GL_STATE_UNKNOWN;
+	vertexArray = GL_STATE_UNKNOWN;
+
+	activeUnit = GL_STATE_UNKNOWN;
+
+	for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+	{
+		textures2D[i] = GL_STATE_UNKNOWN;
+		textureArrays[i] = GL_STATE_UNKNOWN;
+		textureBuffers[i] = GL_STATE_UNKNOWN;
+	}
+
+	arrayBuffer = GL_STATE_UNKNOWN;
+	uniformBuffer = GL_STATE_UNKNOWN;
+
+	blendEnabled = GL_STATE_UNKNOWN;
+	blendSrc = GL_STATE_UNKNOWN;
+	blendDst = GL_STATE_UNKNOWN;
+
+	unpackAlignment = GL_STATE_UNKNOWN;
+}
+
+void GLStateCache::resetStats()
+{
+	stats = {};
+}
+
+bool GLStateCache::change(unsigned int& shadow, unsigned int value)
+{
+	if (shadow == value)
+	{
+		stats.skipped++;
+		return false;
+	}
+
+	shadow = value;
+	stats.issued++;
+
+	return true;
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+	if (change(this->program, program))
+		glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao)
+{
+	if (change(vertexArray, vao))
+		glBindVertexArray(vao);
+}
+
+void GLStateCache::activeTexture(unsigned int unit)
+{
+	if (change(activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	unsigned int* shadow = NULL;
+
+	if (unit < GL_STATE_TEXTURE_UNITS)
+	{
+		if (target == GL_TEXTURE_2D)
+			shadow = &textures2D[unit];
+		else if (target == GL_TEXTURE_2D_ARRAY)
+			shadow = &textureArrays[unit];
+		else if (target == GL_TEXTURE_BUFFER)
+			shadow = &textureBuffers[unit];
+	}
+
+	// Check before switching units, so a redundant bind doesn't cost an activeTexture either
+	if (shadow != NULL && !change(*shadow, texture))
+		return;
+
+	if (shadow == NULL)
+		stats.issued++;
+
+	activeTexture(unit);
+
+	glBindTexture(target, texture);
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+	unsigned int* shadow = NULL;
+
+	if (target == GL_ARRAY_BUFFER)
+		shadow = &arrayBuffer;
+	else if (target == GL_UNIFORM_BUFFER)
+		shadow = &uniformBuffer;
+
+	if (shadow != NULL && !change(*shadow, buffer))
+		return;
+
+	if (shadow == NULL)
+		stats.issued++;
+
+	glBindBuffer(target, buffer);
+}
+
+void GLStateCache::assumeBuffer(GLenum target, unsigned int buffer)
+{
+	if (target == GL_ARRAY_BUFFER)
+		arrayBuffer = buffer;
+	else if (target == GL_UNIFORM_BUFFER)
+		uniformBuffer = buffer;
+}
+
+void GLStateCache::setBlend(bool enabled)
+{
+	if (!change(blendEnabled, enabled ? 1 : 0))
+		return;
+
+	if (enabled)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+	// One call sets both, so count it once
+	if (blendSrc == src && blendDst == dst)
+	{
+		stats.skipped++;
+		return;
+	}
+
+	blendSrc = src;
+	blendDst = dst;
+
+	stats.issued++;
+
+	glBlendFunc(src, dst);
+}
+
+void GLStateCache::pixelStore(GLenum name, int value)
+{
+	if (name != GL_UNPACK_ALIGNMENT)
+	{
+		stats.issued++;
+		glPixelStorei(name, value);
+		return;
+	}
+
+	if (change(unpackAlignment, (unsigned int)value))
+		glPixelStorei(name, value);
+}
+
+GLStateStats GLStateCache::getStats()
+{
+	return stats;
+}
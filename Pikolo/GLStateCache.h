@@ -0,0 +1,72 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Texture units whose bindings are shadowed - binds to higher units are always issued
+#define GL_STATE_TEXTURE_UNITS 16
+
+struct GLStateStats {
+
+	// State calls that reached the GL, and ones dropped because they wouldn't have changed anything
+	int issued;
+	int skipped;
+};
+
+// Shadows the GL state the renderers change every frame and drops calls that would set it to what
+// it already is. Only valid while every call on the context goes through it - invalidate() after
+// anything else has touched the GL.
+class GLStateCache
+{
+private:
+
+	unsigned int program;
+	unsigned int vertexArray;
+
+	unsigned int activeUnit;
+
+	// Per unit bindings, for the targets the renderers sample from
+	unsigned int textures2D[GL_STATE_TEXTURE_UNITS];
+	unsigned int textureArrays[GL_STATE_TEXTURE_UNITS];
+	unsigned int textureBuffers[GL_STATE_TEXTURE_UNITS];
+
+	unsigned int arrayBuffer;
+	unsigned int uniformBuffer;
+
+	unsigned int blendEnabled;
+	unsigned int blendSrc;
+	unsigned int blendDst;
+
+	unsigned int unpackAlignment;
+
+	GLStateStats stats;
+
+	// Updates the shadow copy and returns true if the call needs issuing
+	bool change(unsigned int& shadow, unsigned int value);
+
+public:
+	GLStateCache();
+
+	// Forget everything, so the next call of each kind is issued
+	void invalidate();
+
+	void resetStats();
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+
+	void activeTexture(unsigned int unit);
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+	// GL_ELEMENT_ARRAY_BUFFER is part of the VAO, so binds to it are never skipped
+	void bindBuffer(GLenum target, unsigned int buffer);
+
+	// Record a buffer binding made without going through the cache
+	void assumeBuffer(GLenum target, unsigned int buffer);
+
+	void setBlend(bool enabled);
+	void blendFunc(GLenum src, GLenum dst);
+
+	void pixelStore(GLenum name, int value);
+
+	GLStateStats getStats();
+};
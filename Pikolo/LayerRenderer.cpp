@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+#include "LayerRenderer.h"
+
+#include <cstddef>
+
+LayerRenderer::LayerRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders)
+{
+	this->shaders = shaders;
+
+	for (int layer = (int)TileLayer::WALLS; layer < (int)TileLayer::COUNT; layer++)
+	{
+		LayerBatch& batch = batches[layer];
+
+		batch.capacity = 0;
+
+		glGenVertexArrays(1, &batch.VAO);
+		glGenBuffers(1, &batch.instanceVBO);
+
+		glBindVertexArray(batch.VAO);
+
+		// Same quad as the per-tile path
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+
+		// position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		// texture coord attribute
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		setupInstanceAttributes(batch.instanceVBO);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+LayerRenderer::~LayerRenderer()
+{
+	for (int layer = (int)TileLayer::WALLS; layer < (int)TileLayer::COUNT; layer++)
+	{
+		glDeleteBuffers(1, &batches[layer].instanceVBO);
+		glDeleteVertexArrays(1, &batches[layer].VAO);
+	}
+}
+
+void LayerRenderer::setVisible(RenderCommandList* commands, Dungeon* dungeon, const Box2d& visible, int totalFrames)
+{
+	for (int layer = (int)TileLayer::WALLS; layer < (int)TileLayer::COUNT; layer++)
+	{
+		LayerBatch& batch = batches[layer];
+
+		visibleTiles.clear();
+
+		dungeon->getVisibleLayerTiles((TileLayer)layer, visible, visibleTiles);
+
+		batch.instances.clear();
+
+		for (const LayerTile& t : visibleTiles)
+		{
+			batch.instances.push_back({ glm::vec2((float)t.posX, (float)t.posY), t.id % totalFrames, { 1, 1, 1 } });
+		}
+
+		if (batch.instances.empty())
+			continue;
+
+		if (batch.instances.size() > batch.capacity)
+		{
+			batch.capacity = batch.instances.size();
+
+			commands->bufferData(GL_ARRAY_BUFFER, batch.instanceVBO, batch.capacity * sizeof(TileInstance), batch.instances.data(), GL_DYNAMIC_DRAW);
+		}
+		else
+		{
+			commands->bufferSubData(GL_ARRAY_BUFFER, batch.instanceVBO, 0, batch.instances.size() * sizeof(TileInstance), batch.instances.data());
+		}
+	}
+}
+
+int LayerRenderer::render(RenderCommandList* commands, TileLayer layer, unsigned int tileArray, unsigned int features)
+{
+	if (layer == TileLayer::FLOOR || batches[(int)layer].instances.empty())
+		return 0;
+
+	// Layer cells are never tinted
+	commands->useProgram(shaders->get(features & ~SHADER_TINT)->getId());
+
+	commands->bindVertexArray(batches[(int)layer].VAO);
+
+	commands->bindTexture(0, GL_TEXTURE_2D_ARRAY, tileArray);
+
+	commands->drawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, (int)batches[(int)layer].instances.size());
+
+	return 1;
+}
+
+size_t LayerRenderer::getInstanceCount(TileLayer layer)
+{
+	return batches[(int)layer].instances.size();
+}
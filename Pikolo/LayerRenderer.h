@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderVariants.h"
+#include "TileRenderer.h"
+
+// Instances of one sparse layer's visible cells
+struct LayerBatch {
+
+	unsigned int VAO;
+	unsigned int instanceVBO;
+
+	// Number of instances the instance buffer currently has storage for
+	size_t capacity;
+
+	std::vector<TileInstance> instances;
+};
+
+// Draws the sparse layers above the floor, each as a single instanced call. Only the occupied cells in
+// view are gathered, so a mostly empty layer costs next to nothing.
+class LayerRenderer
+{
+private:
+
+	// Shared with the other instanced renderers
+	ShaderVariants* shaders;
+
+	// One per TileLayer - the floor's entry is unused, it's drawn by the map renderers
+	LayerBatch batches[(int)TileLayer::COUNT];
+
+	// Scratch for the culled cells, kept to avoid reallocating
+	std::vector<LayerTile> visibleTiles;
+
+	LayerRenderer() {}
+
+public:
+	LayerRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders);
+	~LayerRenderer();
+
+	// Re-cull every sparse layer against the box (in world units) - needed when the view or a layer changes
+	void setVisible(RenderCommandList* commands, Dungeon* dungeon, const Box2d& visible, int totalFrames);
+
+	// Draws with the variant for the ShaderFeature bits, returns the number of draw calls recorded
+	int render(RenderCommandList* commands, TileLayer layer, unsigned int tileArray, unsigned int features);
+
+	size_t getInstanceCount(TileLayer layer);
+};
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <math.h>
+
+LightGrid::LightGrid()
+{
+	glGenBuffers(1, &lightBuffer);
+	glGenBuffers(1, &gridBuffer);
+	glGenBuffers(1, &indexBuffer);
+
+	lightTexture = createBufferTexture(lightBuffer, GL_RGBA32F);
+	gridTexture = createBufferTexture(gridBuffer, GL_RG32UI);
+	indexTexture = createBufferTexture(indexBuffer, GL_R32UI);
+
+	stats = {};
+}
+
+LightGrid::~LightGrid()
+{
+	glDeleteTextures(1, &lightTexture);
+	glDeleteTextures(1, &gridTexture);
+	glDeleteTextures(1, &indexTexture);
+
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &gridBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+}
+
+unsigned int LightGrid::createBufferTexture(unsigned int buffer, GLenum format)
+{
+	// The buffer needs storage before it can back a texture - build() replaces it every frame
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	return texture;
+}
+
+template <typename F>
+void LightGrid::forEachTile(const glm::vec3& circle, int tilesX, int tilesY, F add)
+{
+	int firstX = std::max((int)std::floor((circle.x - circle.z) / LIGHT_TILE_SIZE), 0);
+	int lastX = std::min((int)std::floor((circle.x + circle.z) / LIGHT_TILE_SIZE), tilesX - 1);
+	int firstY = std::max((int)std::floor((circle.y - circle.z) / LIGHT_TILE_SIZE), 0);
+	int lastY = std::min((int)std::floor((circle.y + circle.z) / LIGHT_TILE_SIZE), tilesY - 1);
+
+	for (int ty = firstY; ty <= lastY; ty++)
+	{
+		for (int tx = firstX; tx <= lastX; tx++)
+		{
+			// Nearest point of the tile to the centre - the corners of the bounding box are often out of reach
+			float nearestX = glm::clamp(circle.x, (float)(tx * LIGHT_TILE_SIZE), (float)((tx + 1) * LIGHT_TILE_SIZE));
+			float nearestY = glm::clamp(circle.y, (float)(ty * LIGHT_TILE_SIZE), (float)((ty + 1) * LIGHT_TILE_SIZE));
+
+			float dx = circle.x - nearestX;
+			float dy = circle.y - nearestY;
+
+			if ((dx * dx) + (dy * dy) < circle.z * circle.z)
+				add((ty * tilesX) + tx);
+		}
+	}
+}
+
+void LightGrid::build(RenderCommandList* commands, const std::vector<PointLight>& lights, glm::vec2 camera, float zoom, int viewportWidth, int viewportHeight)
+{
+	int tilesX = (viewportWidth + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	int tilesY = (viewportHeight + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	int tileCount = tilesX * tilesY;
+
+	stats = {};
+	stats.total = (int)lights.size();
+
+	lightTexels.clear();
+	circles.clear();
+
+	for (const PointLight& light : lights)
+	{
+		// Pixel coordinates of world positions, matching gl_FragCoord
+		glm::vec2 centre = ((light.position - camera) * zoom) + glm::vec2(viewportWidth * 0.5f, viewportHeight * 0.5f);
+		float radius = light.radius * zoom;
+
+		if (radius <= 0.0f || centre.x + radius < 0.0f || centre.y + radius < 0.0f ||
+			centre.x - radius > viewportWidth || centre.y - radius > viewportHeight)
+			continue;
+
+		lightTexels.push_back(glm::vec4(light.position, light.radius, light.intensity));
+		lightTexels.push_back(glm::vec4(light.colour.r, light.colour.g, light.colour.b, 0.0f));
+
+		circles.push_back(glm::vec3(centre, radius));
+	}
+
+	stats.visible = (int)circles.size();
+
+	// Count, then lay the lists out back to back and fill them
+	grid.assign(tileCount * 2, 0);
+
+	for (const glm::vec3& circle : circles)
+	{
+		forEachTile(circle, tilesX, tilesY, [this](int tile) {
+			if (grid[(tile * 2) + 1] < LIGHT_TILE_MAX)
+				grid[(tile * 2) + 1]++;
+			else
+				stats.dropped++;
+		});
+	}
+
+	unsigned int offset = 0;
+
+	for (int tile = 0; tile < tileCount; tile++)
+	{
+		grid[tile * 2] = offset;
+		offset += grid[(tile * 2) + 1];
+
+		stats.maxPerTile = std::max(stats.maxPerTile, (int)grid[(tile * 2) + 1]);
+
+		grid[(tile * 2) + 1] = 0;
+	}
+
+	indices.resize(offset);
+
+	for (unsigned int i = 0; i < circles.size(); i++)
+	{
+		forEachTile(circles[i], tilesX, tilesY, [this, i](int tile) {
+			if (grid[(tile * 2) + 1] < LIGHT_TILE_MAX)
+			{
+				indices[grid[tile * 2] + grid[(tile * 2) + 1]] = i;
+				grid[(tile * 2) + 1]++;
+			}
+		});
+	}
+
+	stats.indices = (int)offset;
+
+	// Zero sized buffers can't back a texture, so keep at least one entry in each
+	if (lightTexels.empty())
+		lightTexels.resize(2, glm::vec4(0.0f));
+
+	if (indices.empty())
+		indices.push_back(0);
+
+	// Orphaned every frame - the lists are small and change whenever anything moves
+	commands->bufferData(GL_TEXTURE_BUFFER, lightBuffer, lightTexels.size() * sizeof(glm::vec4), lightTexels.data(), GL_STREAM_DRAW);
+	commands->bufferData(GL_TEXTURE_BUFFER, gridBuffer, grid.size() * sizeof(unsigned int), grid.data(), GL_STREAM_DRAW);
+	commands->bufferData(GL_TEXTURE_BUFFER, indexBuffer, indices.size() * sizeof(unsigned int), indices.data(), GL_STREAM_DRAW);
+}
+
+void LightGrid::bind(RenderCommandList* commands)
+{
+	commands->bindTexture(LIGHT_UNIT_LIGHTS, GL_TEXTURE_BUFFER, lightTexture);
+	commands->bindTexture(LIGHT_UNIT_GRID, GL_TEXTURE_BUFFER, gridTexture);
+	commands->bindTexture(LIGHT_UNIT_INDICES, GL_TEXTURE_BUFFER, indexTexture);
+}
+
+LightGridStats LightGrid::getStats()
+{
+	return stats;
+}
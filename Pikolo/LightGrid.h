@@ -0,0 +1,79 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+
+// Most lights kept per screen tile - any more are dropped, which bounds the cost of a fragment
+#define LIGHT_TILE_MAX 32
+
+struct PointLight {
+
+	// World units
+	glm::vec2 position;
+	float radius;
+
+	float intensity;
+
+	Colour colour;
+};
+
+struct LightGridStats {
+
+	// Lights overlapping the screen, out of those given to build()
+	int visible;
+	int total;
+
+	// Entries across every tile's list, and the longest list
+	int indices;
+	int maxPerTile;
+
+	// Lights dropped from full tiles
+	int dropped;
+};
+
+// Culls point lights into LIGHT_TILE_SIZE squares of the screen on the CPU each frame. The lights, each
+// tile's range and the index lists go into buffer textures read by lighting.glsl, so a fragment only
+// loops over the lights that can reach its own tile.
+class LightGrid
+{
+private:
+
+	unsigned int lightBuffer;
+	unsigned int gridBuffer;
+	unsigned int indexBuffer;
+
+	unsigned int lightTexture;
+	unsigned int gridTexture;
+	unsigned int indexTexture;
+
+	// Two texels per visible light
+	std::vector<glm::vec4> lightTexels;
+
+	// First index and count per tile
+	std::vector<unsigned int> grid;
+	std::vector<unsigned int> indices;
+
+	// Screen-space circles of the visible lights, for the tile tests
+	std::vector<glm::vec3> circles;
+
+	LightGridStats stats;
+
+	unsigned int createBufferTexture(unsigned int buffer, GLenum format);
+
+	// Calls add(tile) for each tile of the tilesX x tilesY grid the circle touches
+	template <typename F>
+	void forEachTile(const glm::vec3& circle, int tilesX, int tilesY, F add);
+
+public:
+	LightGrid();
+	~LightGrid();
+
+	// Cull the lights for a viewport centred on camera and record the uploads
+	void build(RenderCommandList* commands, const std::vector<PointLight>& lights, glm::vec2 camera, float zoom, int viewportWidth, int viewportHeight);
+
+	// Record binding the lists to the LIGHT_UNIT_* units
+	void bind(RenderCommandList* commands);
+
+	LightGridStats getStats();
+};
@@ -0,0 +1,409 @@
+#include "stdafx.h"
+
+#include "LodRenderer.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Source over destination, for packed RGBA texels
+static std::uint32_t blendOver(std::uint32_t dst, std::uint32_t src)
+{
+	unsigned int a = src >> 24;
+
+	if (a == 255)
+		return src;
+
+	if (a == 0)
+		return dst;
+
+	std::uint32_t out = 0;
+
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		unsigned int s = (src >> shift) & 0xFF;
+		unsigned int d = (dst >> shift) & 0xFF;
+
+		out |= (((s * a) + (d * (255 - a)) + 127) / 255) << shift;
+	}
+
+	unsigned int da = dst >> 24;
+
+	return out | ((a + ((da * (255 - a)) + 127) / 255) << 24);
+}
+
+// Average of four packed RGBA texels
+static std::uint32_t average4(std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t d)
+{
+	std::uint32_t out = 0;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		unsigned int sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+
+		out |= ((sum + 2) / 4) << shift;
+	}
+
+	return out;
+}
+
+LodRenderer::LodRenderer()
+{
+	dungeon = NULL;
+
+	frameCount = 0;
+
+	shader = new ShaderProgram();
+
+	shader->initFromFiles("./res/shaders/lod.vs", "./res/shaders/lod.fs");
+
+	originLocation = shader->addUniform<glm::vec2>("origin");
+	sizeLocation = shader->addUniform<glm::vec2>("size");
+	nodeLocation = shader->addUniform<int>("node");
+
+	glGenVertexArrays(1, &VAO);
+}
+
+LodRenderer::~LodRenderer()
+{
+	destroy();
+
+	glDeleteVertexArrays(1, &VAO);
+
+	delete shader;
+}
+
+void LodRenderer::destroy()
+{
+	for (LodLevel& level : levels)
+	{
+		for (LodNode& node : level.nodes)
+			glDeleteTextures(1, &node.texture);
+	}
+
+	levels.clear();
+}
+
+void LodRenderer::setAtlas(const unsigned char* atlas, int atlasWidth, int columns, int frames)
+{
+	const int step = MAP_TILE_DIM / LOD_TILE_TEXELS;
+
+	frameCount = frames;
+
+	this->frames.resize(frames * LOD_TILE_TEXELS * LOD_TILE_TEXELS);
+
+	for (int i = 0; i < frames; i++)
+	{
+		int originX = (i % columns) * MAP_TILE_DIM;
+		int originY = (i / columns) * MAP_TILE_DIM;
+
+		for (int ty = 0; ty < LOD_TILE_TEXELS; ty++)
+		{
+			for (int tx = 0; tx < LOD_TILE_TEXELS; tx++)
+			{
+				unsigned int sum[4] = { 0, 0, 0, 0 };
+
+				for (int y = 0; y < step; y++)
+				{
+					const unsigned char* row = &atlas[(((originY + (ty * step) + y) * atlasWidth) + originX + (tx * step)) * 4];
+
+					for (int x = 0; x < step * 4; x++)
+						sum[x & 3] += row[x];
+				}
+
+				std::uint32_t texel = 0;
+
+				for (int c = 0; c < 4; c++)
+					texel |= ((sum[c] + ((step * step) / 2)) / (step * step)) << (c * 8);
+
+				this->frames[(((i * LOD_TILE_TEXELS) + ty) * LOD_TILE_TEXELS) + tx] = texel;
+			}
+		}
+	}
+}
+
+void LodRenderer::bakeLeaf(int nx, int ny)
+{
+	LodNode& node = levels[0].nodes[(ny * levels[0].nodesX) + nx];
+
+	node.pixels.assign(LOD_NODE_TEXELS * LOD_NODE_TEXELS, 0);
+
+	if (frameCount == 0)
+		return;
+
+	int firstX = nx * CHUNK_SIZE;
+	int firstY = ny * CHUNK_SIZE;
+	int endX = std::min(firstX + CHUNK_SIZE, dungeon->getWidth());
+	int endY = std::min(firstY + CHUNK_SIZE, dungeon->getHeight());
+
+	// Writes one frame into the tile's square of the node, blended over what's there
+	auto drawTile = [this, &node, firstX, firstY](int x, int y, unsigned int id, const Colour& tint) {
+		const std::uint32_t* frame = &frames[(id % frameCount) * LOD_TILE_TEXELS * LOD_TILE_TEXELS];
+
+		bool tinted = tint.r != 1.0f || tint.g != 1.0f || tint.b != 1.0f;
+
+		for (int ty = 0; ty < LOD_TILE_TEXELS; ty++)
+		{
+			std::uint32_t* row = &node.pixels[((((y - firstY) * LOD_TILE_TEXELS) + ty) * LOD_NODE_TEXELS) + ((x - firstX) * LOD_TILE_TEXELS)];
+
+			for (int tx = 0; tx < LOD_TILE_TEXELS; tx++)
+			{
+				std::uint32_t texel = frame[(ty * LOD_TILE_TEXELS) + tx];
+
+				if (tinted)
+				{
+					texel = (texel & 0xFF000000u) |
+						(std::uint32_t)((texel & 0xFF) * tint.r) |
+						((std::uint32_t)(((texel >> 8) & 0xFF) * tint.g) << 8) |
+						((std::uint32_t)(((texel >> 16) & 0xFF) * tint.b) << 16);
+				}
+
+				row[tx] = blendOver(row[tx], texel);
+			}
+		}
+	};
+
+	for (int y = firstY; y < endY; y++)
+	{
+		for (int x = firstX; x < endX; x++)
+		{
+			const Tile& t = dungeon->getTile(x, y);
+
+			drawTile(x, y, t.id, t.colour);
+		}
+	}
+
+	// Same order as the GL path - the overhead layer goes in too, since the sprites are too small to matter out here
+	Box2d box = { (float)(firstX * TILE_SIZE), (float)((endX - 1) * TILE_SIZE), (float)(firstY * TILE_SIZE), (float)((endY - 1) * TILE_SIZE) };
+
+	for (int layer = (int)TileLayer::WALLS; layer < (int)TileLayer::COUNT; layer++)
+	{
+		layerTiles.clear();
+
+		dungeon->getVisibleLayerTiles((TileLayer)layer, box, layerTiles);
+
+		for (const LayerTile& t : layerTiles)
+			drawTile(t.posX, t.posY, t.id, { 1, 1, 1 });
+	}
+}
+
+void LodRenderer::bakeParent(int level, int nx, int ny)
+{
+	LodLevel& children = levels[level - 1];
+	LodNode& node = levels[level].nodes[(ny * levels[level].nodesX) + nx];
+
+	const int half = LOD_NODE_TEXELS / 2;
+
+	node.pixels.assign(LOD_NODE_TEXELS * LOD_NODE_TEXELS, 0);
+
+	for (int dy = 0; dy < 2; dy++)
+	{
+		for (int dx = 0; dx < 2; dx++)
+		{
+			int cx = (nx * 2) + dx;
+			int cy = (ny * 2) + dy;
+
+			if (cx >= children.nodesX || cy >= children.nodesY)
+				continue;
+
+			const std::vector<std::uint32_t>& src = children.nodes[(cy * children.nodesX) + cx].pixels;
+
+			for (int y = 0; y < half; y++)
+			{
+				const std::uint32_t* row0 = &src[(y * 2) * LOD_NODE_TEXELS];
+				const std::uint32_t* row1 = row0 + LOD_NODE_TEXELS;
+
+				std::uint32_t* out = &node.pixels[(((dy * half) + y) * LOD_NODE_TEXELS) + (dx * half)];
+
+				for (int x = 0; x < half; x++)
+					out[x] = average4(row0[x * 2], row0[(x * 2) + 1], row1[x * 2], row1[(x * 2) + 1]);
+			}
+		}
+	}
+}
+
+void LodRenderer::build(Dungeon* dungeon)
+{
+	destroy();
+
+	this->dungeon = dungeon;
+
+	int nodesX = (dungeon->getWidth() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	int nodesY = (dungeon->getHeight() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	// Halve until a single node covers the map
+	while (true)
+	{
+		levels.push_back(LodLevel());
+
+		LodLevel& level = levels.back();
+
+		level.nodesX = nodesX;
+		level.nodesY = nodesY;
+		level.nodes.resize(nodesX * nodesY);
+
+		if (nodesX == 1 && nodesY == 1)
+			break;
+
+		nodesX = (nodesX + 1) / 2;
+		nodesY = (nodesY + 1) / 2;
+	}
+
+	int nodeCount = 0;
+
+	for (int l = 0; l < (int)levels.size(); l++)
+	{
+		LodLevel& level = levels[l];
+
+		for (int ny = 0; ny < level.nodesY; ny++)
+		{
+			for (int nx = 0; nx < level.nodesX; nx++)
+			{
+				LodNode& node = level.nodes[(ny * level.nodesX) + nx];
+
+				if (l == 0)
+					bakeLeaf(nx, ny);
+				else
+					bakeParent(l, nx, ny);
+
+				node.dirty = false;
+
+				glGenTextures(1, &node.texture);
+
+				glBindTexture(GL_TEXTURE_2D, node.texture);
+
+				// The level is picked so a node is never shrunk by more than half - no mipmaps needed
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, LOD_NODE_TEXELS, LOD_NODE_TEXELS, 0, GL_RGBA, GL_UNSIGNED_BYTE, node.pixels.data());
+
+				nodeCount++;
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifdef DEBUG_ON
+	printf("Baked %d levels, %d nodes of %d x %d texels...\n", (int)levels.size(), nodeCount, LOD_NODE_TEXELS, LOD_NODE_TEXELS);
+#endif
+}
+
+void LodRenderer::markDirty(int level, int nx, int ny)
+{
+	int index = (ny * levels[level].nodesX) + nx;
+
+	if (!levels[level].nodes[index].dirty)
+	{
+		levels[level].nodes[index].dirty = true;
+		levels[level].dirtyNodes.push_back(index);
+	}
+}
+
+void LodRenderer::update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed)
+{
+	if (dungeon == NULL || changed.empty())
+		return;
+
+	for (glm::ivec2 t : changed)
+		markDirty(0, t.x / CHUNK_SIZE, t.y / CHUNK_SIZE);
+
+	// Each level's re-bakes mark their parents, which are baked on the next pass once all four children are current
+	for (int l = 0; l < (int)levels.size(); l++)
+	{
+		LodLevel& level = levels[l];
+
+		for (int index : level.dirtyNodes)
+		{
+			int nx = index % level.nodesX;
+			int ny = index / level.nodesX;
+
+			if (l == 0)
+				bakeLeaf(nx, ny);
+			else
+				bakeParent(l, nx, ny);
+
+			LodNode& node = level.nodes[index];
+
+			commands->texSubImage2D(GL_TEXTURE_2D, node.texture, 0, 0, LOD_NODE_TEXELS, LOD_NODE_TEXELS,
+				GL_RGBA, GL_UNSIGNED_BYTE, 4, LOD_NODE_TEXELS, node.pixels.data());
+
+			node.dirty = false;
+
+			if (l + 1 < (int)levels.size())
+				markDirty(l + 1, nx / 2, ny / 2);
+		}
+
+		level.dirtyNodes.clear();
+	}
+}
+
+int LodRenderer::getLevel(float zoom)
+{
+	if (levels.empty())
+		return 0;
+
+	// A level k node covers CHUNK_SIZE * TILE_SIZE * 2^k world units
+	float fit = (float)LOD_NODE_TEXELS / ((float)(CHUNK_SIZE * TILE_SIZE) * zoom);
+
+	int level = (int)std::floor(std::log2(fit));
+
+	return glm::clamp(level, 0, (int)levels.size() - 1);
+}
+
+int LodRenderer::getLevelCount()
+{
+	return (int)levels.size();
+}
+
+int LodRenderer::render(RenderCommandList* commands, const Box2d& visible, float zoom)
+{
+	if (levels.empty())
+		return 0;
+
+	int l = getLevel(zoom);
+
+	const LodLevel& level = levels[l];
+
+	const float nodeWorldSize = (float)(CHUNK_SIZE * TILE_SIZE * (1 << l));
+	const float nodeCells = (float)(CHUNK_SIZE << l);
+
+	// Nodes of the corner cells - floored, since the cells can be off the map on either side
+	glm::ivec2 first(glm::floor(glm::vec2(Dungeon::worldToCell(glm::vec2(visible.left, visible.bottom))) / nodeCells));
+	glm::ivec2 last(glm::floor(glm::vec2(Dungeon::worldToCell(glm::vec2(visible.right, visible.top))) / nodeCells));
+
+	int firstX = std::max(first.x, 0);
+	int lastX = std::min(last.x, level.nodesX - 1);
+	int firstY = std::max(first.y, 0);
+	int lastY = std::min(last.y, level.nodesY - 1);
+
+	int draws = 0;
+
+	commands->useProgram(shader->getId());
+
+	commands->setUniform(sizeLocation, glm::vec2(nodeWorldSize, nodeWorldSize));
+	commands->setUniform(nodeLocation, 0);
+
+	commands->bindVertexArray(VAO);
+
+	for (int ny = firstY; ny <= lastY; ny++)
+	{
+		for (int nx = firstX; nx <= lastX; nx++)
+		{
+			// Tiles are centred on their position * TILE_SIZE, so nodes start half a tile early
+			glm::vec2 origin((nx * nodeWorldSize) - (TILE_SIZE / 2), (ny * nodeWorldSize) - (TILE_SIZE / 2));
+
+			commands->setUniform(originLocation, origin);
+
+			commands->bindTexture(0, GL_TEXTURE_2D, level.nodes[(ny * level.nodesX) + nx].texture);
+
+			commands->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+			draws++;
+		}
+	}
+
+	return draws;
+}
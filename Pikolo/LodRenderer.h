@@ -0,0 +1,94 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+
+#include <cstdint>
+
+// Texels per tile side in the finest level of the pyramid, and the size of every node's image
+#define LOD_TILE_TEXELS 8
+#define LOD_NODE_TEXELS (CHUNK_SIZE * LOD_TILE_TEXELS)
+
+// Zoom (pixels per world unit) below which the map is drawn from the pyramid instead of from tiles
+#define LOD_ZOOM_THRESHOLD 0.125f
+
+// A square of the map baked into a single texture
+struct LodNode {
+
+	unsigned int texture;
+
+	// CPU copy of the texture, RGBA with red in the low byte - the source for the parent's downsample
+	std::vector<std::uint32_t> pixels;
+
+	bool dirty;
+};
+
+// Level 0 has a node per chunk, each level above halves the resolution and covers 2 x 2 nodes of the one below
+struct LodLevel {
+
+	int nodesX;
+	int nodesY;
+
+	std::vector<LodNode> nodes;
+
+	// Indices of nodes waiting to be re-baked
+	std::vector<int> dirtyNodes;
+};
+
+// Draws zoomed out views from a quadtree of pre-baked map images. Every layer of a chunk is composed into
+// a leaf on the CPU, and parents are box-filtered from their children, so an edit only re-bakes one node
+// per level. The level is picked so nodes stay about LOD_NODE_TEXELS pixels on screen, which keeps the
+// number of draws bounded however far out the camera goes.
+class LodRenderer
+{
+private:
+
+	// Attribute-less VAO for the node quads
+	unsigned int VAO;
+
+	ShaderProgram* shader;
+
+	Uniform<glm::vec2> originLocation;
+	Uniform<glm::vec2> sizeLocation;
+	Uniform<int> nodeLocation;
+
+	Dungeon* dungeon;
+
+	std::vector<LodLevel> levels;
+
+	// Each atlas frame box-filtered down to LOD_TILE_TEXELS square
+	std::vector<std::uint32_t> frames;
+	int frameCount;
+
+	// Scratch for the sparse layer cells of a chunk, kept to avoid reallocating
+	std::vector<LayerTile> layerTiles;
+
+	void markDirty(int level, int nx, int ny);
+	void bakeLeaf(int nx, int ny);
+	void bakeParent(int level, int nx, int ny);
+
+	void destroy();
+
+public:
+	LodRenderer();
+	~LodRenderer();
+
+	// Downsamples each MAP_TILE_DIM frame of the RGBA atlas - call before build()
+	void setAtlas(const unsigned char* atlas, int atlasWidth, int columns, int frames);
+
+	// Bakes and uploads the whole pyramid - call again after regenerating the dungeon
+	void build(Dungeon* dungeon);
+
+	// Re-bakes the leaves holding the changed tiles and each of their ancestors
+	void update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed);
+
+	// Coarsest level whose nodes aren't magnified at this zoom
+	int getLevel(float zoom);
+	int getLevelCount();
+
+	// Draws the nodes of the zoom's level overlapping the box (in world units), returns the number of draw calls recorded
+	int render(RenderCommandList* commands, const Box2d& visible, float zoom);
+};
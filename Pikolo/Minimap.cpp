@@ -0,0 +1,250 @@
+#include "stdafx.h"
+
+#include "Minimap.h"
+
+#include <algorithm>
+
+Minimap::Minimap()
+{
+	dungeon = NULL;
+
+	width = 0;
+	height = 0;
+
+	blocksX = 0;
+
+	lastReveal = glm::ivec2(-1, -1);
+
+	uploadedTexels = 0;
+
+	shader = new ShaderProgram();
+
+	shader->initFromFiles("./res/shaders/minimap.vs", "./res/shaders/minimap.fs");
+
+	rectMinLocation = shader->addUniform<glm::vec2>("rectMin");
+	rectMaxLocation = shader->addUniform<glm::vec2>("rectMax");
+	markerLocation = shader->addUniform<glm::vec2>("marker");
+	mapLocation = shader->addUniform<int>("map");
+
+	glGenVertexArrays(1, &VAO);
+
+	glGenTextures(1, &texture);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// A texel per tile, so no filtering - shrinking the map below one pixel per tile just drops rows
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+Minimap::~Minimap()
+{
+	glDeleteTextures(1, &texture);
+	glDeleteVertexArrays(1, &VAO);
+
+	delete shader;
+}
+
+void Minimap::setPalette(const unsigned char* atlas, int atlasWidth, int columns, int frames)
+{
+	palette.resize(frames);
+
+	for (int i = 0; i < frames; i++)
+	{
+		int originX = (i % columns) * MAP_TILE_DIM;
+		int originY = (i / columns) * MAP_TILE_DIM;
+
+		unsigned int sum[3] = { 0, 0, 0 };
+
+		for (int y = 0; y < MAP_TILE_DIM; y++)
+		{
+			const unsigned char* row = &atlas[(((originY + y) * atlasWidth) + originX) * 4];
+
+			for (int x = 0; x < MAP_TILE_DIM; x++)
+			{
+				sum[0] += row[(x * 4) + 0];
+				sum[1] += row[(x * 4) + 1];
+				sum[2] += row[(x * 4) + 2];
+			}
+		}
+
+		const unsigned int count = MAP_TILE_DIM * MAP_TILE_DIM;
+
+		palette[i] = (sum[0] / count) | ((sum[1] / count) << 8) | ((sum[2] / count) << 16) | 0xFF000000u;
+	}
+}
+
+void Minimap::build(Dungeon* dungeon)
+{
+	int maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+	if (dungeon->getWidth() > maxSize || dungeon->getHeight() > maxSize)
+	{
+		printf("Dungeon is %d x %d tiles but textures are limited to %d - no minimap\n", dungeon->getWidth(), dungeon->getHeight(), maxSize);
+
+		this->dungeon = NULL;
+		return;
+	}
+
+	this->dungeon = dungeon;
+
+	width = dungeon->getWidth();
+	height = dungeon->getHeight();
+
+	texels.assign(width * height, MINIMAP_HIDDEN);
+	discovered.assign(width * height, 0);
+
+	blocksX = (width + MINIMAP_BLOCK - 1) / MINIMAP_BLOCK;
+	blockDirty.assign(blocksX * ((height + MINIMAP_BLOCK - 1) / MINIMAP_BLOCK), 0);
+	dirtyBlocks.clear();
+
+	lastReveal = glm::ivec2(-1, -1);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifdef DEBUG_ON
+	printf("Uploaded %d x %d minimap texture...\n", width, height);
+#endif
+}
+
+std::uint32_t Minimap::tileColour(int x, int y)
+{
+	if (dungeon->getLayerTile(TileLayer::WALLS, x, y) != LAYER_EMPTY)
+		return MINIMAP_WALL;
+
+	if (palette.empty())
+		return 0xFFFFFFFFu;
+
+	return palette[dungeon->getTile(x, y).id % palette.size()];
+}
+
+void Minimap::setTexel(int x, int y)
+{
+	std::uint32_t colour = tileColour(x, y);
+
+	if (texels[(y * width) + x] == colour)
+		return;
+
+	texels[(y * width) + x] = colour;
+
+	int block = ((y / MINIMAP_BLOCK) * blocksX) + (x / MINIMAP_BLOCK);
+
+	if (!blockDirty[block])
+	{
+		blockDirty[block] = 1;
+		dirtyBlocks.push_back(block);
+	}
+}
+
+void Minimap::reveal(glm::vec2 position, int radius)
+{
+	if (dungeon == NULL)
+		return;
+
+	glm::ivec2 centre = Dungeon::worldToCell(position);
+
+	if (centre == lastReveal)
+		return;
+
+	lastReveal = centre;
+
+	int firstX = std::max(centre.x - radius, 0);
+	int lastX = std::min(centre.x + radius, width - 1);
+	int firstY = std::max(centre.y - radius, 0);
+	int lastY = std::min(centre.y + radius, height - 1);
+
+	for (int y = firstY; y <= lastY; y++)
+	{
+		for (int x = firstX; x <= lastX; x++)
+		{
+			int dx = x - centre.x;
+			int dy = y - centre.y;
+
+			if ((dx * dx) + (dy * dy) > radius * radius || discovered[(y * width) + x])
+				continue;
+
+			discovered[(y * width) + x] = 1;
+
+			setTexel(x, y);
+		}
+	}
+}
+
+void Minimap::update(const std::vector<glm::ivec2>& changed)
+{
+	if (dungeon == NULL)
+		return;
+
+	// Hidden tiles pick up their current colour when they're discovered
+	for (glm::ivec2 t : changed)
+	{
+		if (discovered[(t.y * width) + t.x])
+			setTexel(t.x, t.y);
+	}
+}
+
+void Minimap::upload(RenderCommandList* commands)
+{
+	uploadedTexels = 0;
+
+	// Blocks rather than one bounding rectangle, so edits at opposite ends of a large map don't send everything between them
+	for (int block : dirtyBlocks)
+	{
+		int x = (block % blocksX) * MINIMAP_BLOCK;
+		int y = (block / blocksX) * MINIMAP_BLOCK;
+
+		int w = std::min(MINIMAP_BLOCK, width - x);
+		int h = std::min(MINIMAP_BLOCK, height - y);
+
+		commands->texSubImage2D(GL_TEXTURE_2D, texture, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 4, width, &texels[(y * width) + x]);
+
+		blockDirty[block] = 0;
+
+		uploadedTexels += w * h;
+	}
+
+	dirtyBlocks.clear();
+}
+
+int Minimap::render(RenderCommandList* commands, glm::vec2 player, int viewportWidth, int viewportHeight)
+{
+	if (dungeon == NULL)
+		return 0;
+
+	// Fit the longer side to MINIMAP_SIZE pixels, keeping the map's shape
+	float scale = (float)MINIMAP_SIZE / (float)std::max(width, height);
+
+	glm::vec2 size = glm::vec2(width * scale * 2.0f / viewportWidth, height * scale * 2.0f / viewportHeight);
+	glm::vec2 rectMax = glm::vec2(1.0f - (MINIMAP_MARGIN * 2.0f / viewportWidth), 1.0f - (MINIMAP_MARGIN * 2.0f / viewportHeight));
+
+	glm::vec2 marker(Dungeon::worldToCell(player));
+
+	commands->useProgram(shader->getId());
+
+	commands->setUniform(rectMinLocation, rectMax - size);
+	commands->setUniform(rectMaxLocation, rectMax);
+	commands->setUniform(markerLocation, marker);
+	commands->setUniform(mapLocation, 0);
+
+	commands->bindTexture(0, GL_TEXTURE_2D, texture);
+
+	commands->bindVertexArray(VAO);
+
+	commands->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	return 1;
+}
+
+int Minimap::getUploadedTexels()
+{
+	return uploadedTexels;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+
+#include <cstdint>
+
+// Tiles per side of the squares the texture is re-uploaded in
+#define MINIMAP_BLOCK CHUNK_SIZE
+
+// Pixels the longer side of the overlay covers, and its gap from the window edges
+#define MINIMAP_SIZE 160
+#define MINIMAP_MARGIN 8
+
+// Tiles round the player discovered each step
+#define MINIMAP_REVEAL_RADIUS 6
+
+// RGBA texels, red in the low byte - undiscovered tiles are translucent black, walls a flat grey
+#define MINIMAP_HIDDEN 0xA0000000u
+#define MINIMAP_WALL 0xFFB4B4B4u
+
+// Whole-dungeon overview with one texel per tile, drawn in the top right corner. The texture is only
+// written at build time - after that just the blocks holding edited or newly discovered tiles are
+// re-uploaded, so the per-frame cost follows what changed rather than the size of the map.
+class Minimap
+{
+private:
+
+	// Attribute-less VAO for the corner quad
+	unsigned int VAO;
+
+	unsigned int texture;
+
+	ShaderProgram* shader;
+
+	Uniform<glm::vec2> rectMinLocation;
+	Uniform<glm::vec2> rectMaxLocation;
+	Uniform<glm::vec2> markerLocation;
+	Uniform<int> mapLocation;
+
+	Dungeon* dungeon;
+
+	int width;
+	int height;
+
+	// Average colour of each atlas frame, RGBA
+	std::vector<std::uint32_t> palette;
+
+	// CPU copy of the texture, used as the source for the block updates
+	std::vector<std::uint32_t> texels;
+
+	// One flag per tile - tiles stay hidden until the player has been near them
+	std::vector<unsigned char> discovered;
+
+	// MINIMAP_BLOCK squares waiting to be uploaded, each listed once
+	int blocksX;
+	std::vector<unsigned char> blockDirty;
+	std::vector<int> dirtyBlocks;
+
+	// Tile the last reveal() was centred on, so standing still costs nothing
+	glm::ivec2 lastReveal;
+
+	int uploadedTexels;
+
+	std::uint32_t tileColour(int x, int y);
+	void setTexel(int x, int y);
+
+public:
+	Minimap();
+	~Minimap();
+
+	// Averages each MAP_TILE_DIM frame of the RGBA atlas - call before build()
+	void setPalette(const unsigned char* atlas, int atlasWidth, int columns, int frames);
+
+	// Allocates and uploads the texture with every tile hidden - call again after regenerating the dungeon
+	void build(Dungeon* dungeon);
+
+	// Discovers the tiles within radius tiles of position (in world units)
+	void reveal(glm::vec2 position, int radius);
+
+	// Recolours edited tiles that have already been discovered
+	void update(const std::vector<glm::ivec2>& changed);
+
+	// Records an upload of each block touched since the last call
+	void upload(RenderCommandList* commands);
+
+	// Returns the number of draw calls recorded
+	int render(RenderCommandList* commands, glm::vec2 player, int viewportWidth, int viewportHeight);
+
+	// Texels sent by the last upload()
+	int getUploadedTexels();
+};
@@ -0,0 +1,1080 @@
+#include "stdafx.h"
+
+#include "NullGL.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+static bool loaded = false;
+
+static NullGLStats current = {};
+
+static std::vector<NullGLCall> calls;
+static std::vector<NullGLCall> lastCalls;
+
+// Every object type shares one counter, so names are unique across types
+static GLuint nextName = 1;
+
+static std::map<std::string, GLint> locations;
+
+// A uniform or vertex input a linked program declares
+struct NullResource {
+
+	// As glGetActiveUniform would give it - arrays end in [0]
+	std::string name;
+	GLenum type;
+	GLint size;
+
+	// Uniforms only - the block a member is in (-1 for none) and its std140 offset
+	GLint blockIndex;
+	GLint offset;
+
+	// Vertex inputs only - from layout (location = n), -1 without one
+	GLint location;
+};
+
+struct NullBlock {
+
+	std::string name;
+	GLint dataSize;
+	GLuint binding;
+};
+
+// What the introspection queries report for a program, read from its shaders' sources when it's linked.
+// Everything declared counts as active - unlike a driver, nothing unused is optimised out.
+struct NullProgram {
+
+	std::vector<NullResource> uniforms;
+	std::vector<NullResource> attributes;
+	std::vector<NullBlock> blocks;
+};
+
+static std::map<GLuint, GLenum> shaderTypes;
+static std::map<GLuint, std::string> shaderSources;
+static std::map<GLuint, std::vector<GLuint>> attachedShaders;
+static std::map<GLuint, NullProgram> programs;
+
+static std::uint64_t bitsOf(float f)
+{
+	std::uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static std::uint64_t bitsOf(const void* p)
+{
+	return (std::uint64_t)(uintptr_t)p;
+}
+
+static void record(const char* name, size_t bytes, std::initializer_list<std::uint64_t> args)
+{
+	NullGLCall call;
+
+	call.name = name;
+	call.argCount = 0;
+	call.bytes = bytes;
+
+	for (std::uint64_t a : args)
+	{
+		if (call.argCount == 6)
+			break;
+
+		call.args[call.argCount++] = a;
+	}
+
+	calls.push_back(call);
+
+	current.calls++;
+	current.bytesUploaded += bytes;
+}
+
+static void recordState(const char* name, std::initializer_list<std::uint64_t> args)
+{
+	record(name, 0, args);
+	current.stateChanges++;
+}
+
+static void recordUniform(const char* name, GLint location)
+{
+	record(name, 0, { (std::uint64_t)location });
+	current.uniformSets++;
+}
+
+static void recordDraw(const char* name, std::initializer_list<std::uint64_t> args)
+{
+	record(name, 0, args);
+	current.drawCalls++;
+}
+
+static void generate(GLsizei n, GLuint* names)
+{
+	for (GLsizei i = 0; i < n; i++)
+		names[i] = nextName++;
+}
+
+static size_t texelSize(GLenum format, GLenum type)
+{
+	size_t components = 4;
+
+	switch (format)
+	{
+	case GL_RED: case GL_RED_INTEGER: components = 1; break;
+	case GL_RG: case GL_RG_INTEGER: components = 2; break;
+	case GL_RGB: case GL_RGB_INTEGER: components = 3; break;
+	}
+
+	switch (type)
+	{
+	case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+	case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+	}
+
+	return components;
+}
+
+// ---------- Shader sources ----------
+
+// GL type and std140 size and alignment of each GLSL type the shaders declare - samplers take no block space
+struct NullType {
+
+	GLenum type;
+	GLint size;
+	GLint align;
+};
+
+static const std::map<std::string, NullType> glslTypes = {
+	{ "float", { GL_FLOAT, 4, 4 } },
+	{ "vec2", { GL_FLOAT_VEC2, 8, 8 } },
+	{ "vec3", { GL_FLOAT_VEC3, 12, 16 } },
+	{ "vec4", { GL_FLOAT_VEC4, 16, 16 } },
+	{ "int", { GL_INT, 4, 4 } },
+	{ "ivec2", { GL_INT_VEC2, 8, 8 } },
+	{ "ivec3", { GL_INT_VEC3, 12, 16 } },
+	{ "ivec4", { GL_INT_VEC4, 16, 16 } },
+	{ "uint", { GL_UNSIGNED_INT, 4, 4 } },
+	{ "uvec2", { GL_UNSIGNED_INT_VEC2, 8, 8 } },
+	{ "uvec3", { GL_UNSIGNED_INT_VEC3, 12, 16 } },
+	{ "uvec4", { GL_UNSIGNED_INT_VEC4, 16, 16 } },
+	{ "bool", { GL_BOOL, 4, 4 } },
+	{ "bvec2", { GL_BOOL_VEC2, 8, 8 } },
+	{ "bvec3", { GL_BOOL_VEC3, 12, 16 } },
+	{ "bvec4", { GL_BOOL_VEC4, 16, 16 } },
+	{ "mat2", { GL_FLOAT_MAT2, 32, 16 } },
+	{ "mat3", { GL_FLOAT_MAT3, 48, 16 } },
+	{ "mat4", { GL_FLOAT_MAT4, 64, 16 } },
+	{ "sampler2D", { GL_SAMPLER_2D, 0, 0 } },
+	{ "sampler3D", { GL_SAMPLER_3D, 0, 0 } },
+	{ "samplerCube", { GL_SAMPLER_CUBE, 0, 0 } },
+	{ "sampler2DArray", { GL_SAMPLER_2D_ARRAY, 0, 0 } },
+	{ "samplerBuffer", { GL_SAMPLER_BUFFER, 0, 0 } },
+	{ "isampler2D", { GL_INT_SAMPLER_2D, 0, 0 } },
+	{ "isampler2DArray", { GL_INT_SAMPLER_2D_ARRAY, 0, 0 } },
+	{ "isamplerBuffer", { GL_INT_SAMPLER_BUFFER, 0, 0 } },
+	{ "usampler2D", { GL_UNSIGNED_INT_SAMPLER_2D, 0, 0 } },
+	{ "usampler2DArray", { GL_UNSIGNED_INT_SAMPLER_2D_ARRAY, 0, 0 } },
+	{ "usamplerBuffer", { GL_UNSIGNED_INT_SAMPLER_BUFFER, 0, 0 } },
+};
+
+static GLint roundUp(GLint value, GLint multiple)
+{
+	return multiple > 0 ? ((value + multiple - 1) / multiple) * multiple : value;
+}
+
+// Drops comments, and the lines #ifdef, #ifndef and #else rule out given the source's own #defines. #if
+// isn't evaluated - only #if 0 is taken as false.
+static std::string preprocess(const std::string& source)
+{
+	std::string stripped;
+
+	size_t i = 0;
+
+	while (i < source.size())
+	{
+		if (source.compare(i, 2, "//") == 0)
+		{
+			size_t end = source.find('\n', i);
+			i = end == std::string::npos ? source.size() : end;
+		}
+		else if (source.compare(i, 2, "/*") == 0)
+		{
+			size_t end = source.find("*/", i + 2);
+			i = end == std::string::npos ? source.size() : end + 2;
+
+			stripped += ' ';
+		}
+		else
+		{
+			stripped += source[i++];
+		}
+	}
+
+	std::set<std::string> defines;
+
+	// Whether each enclosing branch is taken
+	std::vector<bool> branches;
+
+	std::istringstream lines(stripped);
+	std::string line;
+	std::string kept;
+
+	while (std::getline(lines, line))
+	{
+		std::istringstream words(line);
+		std::string directive;
+		std::string name;
+
+		words >> directive >> name;
+
+		bool taken = std::find(branches.begin(), branches.end(), false) == branches.end();
+
+		if (directive == "#ifdef" || directive == "#ifndef")
+			branches.push_back((defines.count(name) > 0) == (directive == "#ifdef"));
+		else if (directive == "#if")
+			branches.push_back(name != "0");
+		else if (directive == "#else" && !branches.empty())
+			branches.back() = !branches.back();
+		else if (directive == "#endif" && !branches.empty())
+			branches.pop_back();
+		else if (taken && directive == "#define")
+			defines.insert(name);
+		else if (taken && directive.compare(0, 1, "#") != 0)
+			kept += line + "\n";
+	}
+
+	return kept;
+}
+
+// Identifiers and numbers as whole tokens, every other non-space character on its own
+static std::vector<std::string> tokenize(const std::string& source)
+{
+	std::vector<std::string> tokens;
+
+	size_t i = 0;
+
+	while (i < source.size())
+	{
+		unsigned char c = source[i];
+
+		if (isalnum(c) || c == '_' || c == '.')
+		{
+			size_t start = i;
+
+			while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_' || source[i] == '.'))
+				i++;
+
+			tokens.push_back(source.substr(start, i - start));
+		}
+		else
+		{
+			if (!isspace(c))
+				tokens.push_back(std::string(1, (char)c));
+
+			i++;
+		}
+	}
+
+	return tokens;
+}
+
+// Takes the layout (...) and interpolation/precision qualifiers off a declaration, keeping any location
+static std::vector<std::string> stripQualifiers(const std::vector<std::string>& statement, GLint& location)
+{
+	static const std::set<std::string> qualifiers = { "flat", "smooth", "noperspective", "centroid", "invariant", "highp", "mediump", "lowp" };
+
+	std::vector<std::string> words;
+
+	location = -1;
+
+	for (size_t i = 0; i < statement.size(); i++)
+	{
+		if (statement[i] == "layout")
+		{
+			size_t close = std::find(statement.begin() + i, statement.end(), ")") - statement.begin();
+
+			for (size_t j = i; j + 2 < close; j++)
+			{
+				if (statement[j] == "location" && statement[j + 1] == "=")
+					location = atoi(statement[j + 2].c_str());
+			}
+
+			i = close;
+		}
+		else if (qualifiers.count(statement[i]) == 0)
+		{
+			words.push_back(statement[i]);
+		}
+	}
+
+	return words;
+}
+
+// The names declared from words[first] on, with their array sizes - initialisers are skipped
+static std::vector<std::pair<std::string, GLint>> declarators(const std::vector<std::string>& words, size_t first)
+{
+	std::vector<std::pair<std::string, GLint>> names;
+
+	for (size_t i = first; i < words.size(); i++)
+	{
+		std::string name = words[i];
+		GLint size = 1;
+
+		if (i + 3 < words.size() && words[i + 1] == "[")
+		{
+			size = atoi(words[i + 2].c_str());
+			i += 3;
+		}
+
+		names.push_back({ size > 1 ? name + "[0]" : name, size });
+
+		while (i + 1 < words.size() && words[i + 1] != ",")
+			i++;
+
+		i++;
+	}
+
+	return names;
+}
+
+static bool declares(const std::vector<NullResource>& table, const std::string& name)
+{
+	return std::any_of(table.begin(), table.end(), [&](const NullResource& r) { return r.name == name; });
+}
+
+// A global uniform, or an input of a vertex shader. Both stages often declare the same uniform, and it only counts once.
+static void declare(const std::vector<std::string>& statement, bool vertex, NullProgram& program)
+{
+	GLint location;
+	std::vector<std::string> words = stripQualifiers(statement, location);
+
+	if (words.size() < 3)
+		return;
+
+	bool uniform = words[0] == "uniform";
+
+	if (!uniform && !(vertex && words[0] == "in"))
+		return;
+
+	auto type = glslTypes.find(words[1]);
+
+	if (type == glslTypes.end())
+		return;
+
+	std::vector<NullResource>& table = uniform ? program.uniforms : program.attributes;
+
+	for (auto& name : declarators(words, 2))
+	{
+		if (!declares(table, name.first))
+			table.push_back({ name.first, type->second.type, name.second, -1, -1, location });
+	}
+}
+
+// A uniform block's members, laid out by the std140 rules. Members of a block with an instance name are
+// reported as Block.member, like a driver does.
+static void declareBlock(const std::string& name, const std::string& instance, const std::vector<std::string>& members, NullProgram& program)
+{
+	if (std::any_of(program.blocks.begin(), program.blocks.end(), [&](const NullBlock& b) { return b.name == name; }))
+		return;
+
+	GLint index = (GLint)program.blocks.size();
+	GLint offset = 0;
+
+	std::vector<std::string> statement;
+
+	for (const std::string& token : members)
+	{
+		if (token != ";")
+		{
+			statement.push_back(token);
+			continue;
+		}
+
+		GLint location;
+		std::vector<std::string> words = stripQualifiers(statement, location);
+
+		statement.clear();
+
+		auto type = words.size() >= 2 ? glslTypes.find(words[0]) : glslTypes.end();
+
+		if (type == glslTypes.end())
+			continue;
+
+		for (auto& member : declarators(words, 1))
+		{
+			// Array elements are padded out to a vec4 each
+			bool array = member.second > 1;
+			GLint stride = array ? roundUp(type->second.size, 16) : type->second.size;
+
+			offset = roundUp(offset, array ? 16 : type->second.align);
+
+			program.uniforms.push_back({ instance.empty() ? member.first : instance + "." + member.first, type->second.type, member.second, index, offset, -1 });
+
+			offset += stride * member.second;
+		}
+	}
+
+	program.blocks.push_back({ name, roundUp(offset, 16), 0 });
+}
+
+static size_t closingBrace(const std::vector<std::string>& tokens, size_t open)
+{
+	int depth = 0;
+
+	for (size_t i = open; i < tokens.size(); i++)
+	{
+		if (tokens[i] == "{")
+			depth++;
+		else if (tokens[i] == "}" && --depth == 0)
+			return i;
+	}
+
+	return tokens.size();
+}
+
+// Adds what a shader declares at global scope - function and struct bodies are skipped over
+static void scan(const std::string& source, bool vertex, NullProgram& program)
+{
+	std::vector<std::string> tokens = tokenize(preprocess(source));
+	std::vector<std::string> statement;
+
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		if (tokens[i] == ";")
+		{
+			declare(statement, vertex, program);
+			statement.clear();
+		}
+		else if (tokens[i] == "{")
+		{
+			size_t close = closingBrace(tokens, i);
+
+			GLint location;
+			std::vector<std::string> words = stripQualifiers(statement, location);
+
+			if (words.size() == 2 && words[0] == "uniform")
+			{
+				std::string instance = close + 1 < tokens.size() && tokens[close + 1] != ";" ? tokens[close + 1] : "";
+
+				declareBlock(words[1], instance, std::vector<std::string>(tokens.begin() + i + 1, tokens.begin() + close), program);
+			}
+
+			statement.clear();
+
+			i = close;
+		}
+		else
+		{
+			statement.push_back(tokens[i]);
+		}
+	}
+}
+
+// ---------- Stubs ----------
+
+static const GLubyte* APIENTRY nullGetString(GLenum name)
+{
+	record("glGetString", 0, { name });
+
+	if (name == GL_VERSION)
+		return (const GLubyte*)"3.3 Pikolo null";
+
+	return (const GLubyte*)"Pikolo null";
+}
+
+static const GLubyte* APIENTRY nullGetStringi(GLenum name, GLuint index)
+{
+	record("glGetStringi", 0, { name, index });
+
+	// glad needs at least one extension string to report success
+	return (const GLubyte*)"GL_PIKOLO_null";
+}
+
+static void APIENTRY nullGetIntegerv(GLenum pname, GLint* data)
+{
+	record("glGetIntegerv", 0, { pname });
+
+	switch (pname)
+	{
+	case GL_NUM_EXTENSIONS: *data = 1; break;
+	case GL_MAX_ARRAY_TEXTURE_LAYERS: *data = 2048; break;
+	case GL_MAX_TEXTURE_SIZE: *data = 16384; break;
+	default: *data = 0; break;
+	}
+}
+
+static void APIENTRY nullViewport(GLint x, GLint y, GLsizei width, GLsizei height) { recordState("glViewport", { (std::uint64_t)x, (std::uint64_t)y, (std::uint64_t)width, (std::uint64_t)height }); }
+static void APIENTRY nullClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) { recordState("glClearColor", { bitsOf(r), bitsOf(g), bitsOf(b), bitsOf(a) }); }
+static void APIENTRY nullClear(GLbitfield mask) { record("glClear", 0, { mask }); }
+static void APIENTRY nullEnable(GLenum cap) { recordState("glEnable", { cap }); }
+static void APIENTRY nullDisable(GLenum cap) { recordState("glDisable", { cap }); }
+static void APIENTRY nullBlendFunc(GLenum src, GLenum dst) { recordState("glBlendFunc", { src, dst }); }
+static void APIENTRY nullPixelStorei(GLenum pname, GLint param) { recordState("glPixelStorei", { pname, (std::uint64_t)param }); }
+
+// Buffers
+static void APIENTRY nullGenBuffers(GLsizei n, GLuint* buffers) { record("glGenBuffers", 0, { (std::uint64_t)n }); generate(n, buffers); }
+static void APIENTRY nullDeleteBuffers(GLsizei n, const GLuint* buffers) { record("glDeleteBuffers", 0, { (std::uint64_t)n }); }
+static void APIENTRY nullBindBuffer(GLenum target, GLuint buffer) { recordState("glBindBuffer", { target, buffer }); }
+static void APIENTRY nullBindBufferBase(GLenum target, GLuint index, GLuint buffer) { recordState("glBindBufferBase", { target, index, buffer }); }
+
+static void APIENTRY nullBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	record("glBufferData", data != NULL ? (size_t)size : 0, { target, (std::uint64_t)size, bitsOf(data), usage });
+}
+
+static void APIENTRY nullBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	record("glBufferSubData", (size_t)size, { target, (std::uint64_t)offset, (std::uint64_t)size, bitsOf(data) });
+}
+
+static void* APIENTRY nullMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	record("glMapBufferRange", 0, { target, (std::uint64_t)offset, (std::uint64_t)length, access });
+
+	// No storage to hand out - callers fall back as they would on a driver refusing the mapping
+	return NULL;
+}
+
+static GLboolean APIENTRY nullUnmapBuffer(GLenum target) { record("glUnmapBuffer", 0, { target }); return GL_TRUE; }
+
+// Vertex arrays
+static void APIENTRY nullGenVertexArrays(GLsizei n, GLuint* arrays) { record("glGenVertexArrays", 0, { (std::uint64_t)n }); generate(n, arrays); }
+static void APIENTRY nullDeleteVertexArrays(GLsizei n, const GLuint* arrays) { record("glDeleteVertexArrays", 0, { (std::uint64_t)n }); }
+static void APIENTRY nullBindVertexArray(GLuint array) { recordState("glBindVertexArray", { array }); }
+static void APIENTRY nullEnableVertexAttribArray(GLuint index) { recordState("glEnableVertexAttribArray", { index }); }
+static void APIENTRY nullVertexAttribDivisor(GLuint index, GLuint divisor) { recordState("glVertexAttribDivisor", { index, divisor }); }
+
+static void APIENTRY nullVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	recordState("glVertexAttribPointer", { index, (std::uint64_t)size, type, normalized, (std::uint64_t)stride, bitsOf(pointer) });
+}
+
+static void APIENTRY nullVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer)
+{
+	recordState("glVertexAttribIPointer", { index, (std::uint64_t)size, type, (std::uint64_t)stride, bitsOf(pointer) });
+}
+
+// Textures
+static void APIENTRY nullGenTextures(GLsizei n, GLuint* textures) { record("glGenTextures", 0, { (std::uint64_t)n }); generate(n, textures); }
+static void APIENTRY nullDeleteTextures(GLsizei n, const GLuint* textures) { record("glDeleteTextures", 0, { (std::uint64_t)n }); }
+static void APIENTRY nullActiveTexture(GLenum texture) { recordState("glActiveTexture", { texture }); }
+static void APIENTRY nullBindTexture(GLenum target, GLuint texture) { recordState("glBindTexture", { target, texture }); }
+static void APIENTRY nullTexParameteri(GLenum target, GLenum pname, GLint param) { recordState("glTexParameteri", { target, pname, (std::uint64_t)param }); }
+static void APIENTRY nullGenerateMipmap(GLenum target) { record("glGenerateMipmap", 0, { target }); }
+
+static void APIENTRY nullTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	size_t bytes = pixels != NULL ? (size_t)width * height * texelSize(format, type) : 0;
+
+	record("glTexImage2D", bytes, { target, (std::uint64_t)level, (std::uint64_t)internalformat, (std::uint64_t)width, (std::uint64_t)height, format });
+}
+
+static void APIENTRY nullTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	size_t bytes = pixels != NULL ? (size_t)width * height * depth * texelSize(format, type) : 0;
+
+	record("glTexImage3D", bytes, { target, (std::uint64_t)level, (std::uint64_t)internalformat, (std::uint64_t)width, (std::uint64_t)height, (std::uint64_t)depth });
+}
+
+static void APIENTRY nullTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+	size_t bytes = pixels != NULL ? (size_t)width * height * texelSize(format, type) : 0;
+
+	record("glTexSubImage2D", bytes, { target, (std::uint64_t)level, (std::uint64_t)xoffset, (std::uint64_t)yoffset, (std::uint64_t)width, (std::uint64_t)height });
+}
+
+static void APIENTRY nullTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) { record("glTexBuffer", 0, { target, internalformat, buffer }); }
+
+// There's no framebuffer, so reads come back black
+static void APIENTRY nullReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+	record("glReadPixels", 0, { (std::uint64_t)x, (std::uint64_t)y, (std::uint64_t)width, (std::uint64_t)height, format, type });
+
+	if (pixels != NULL)
+		memset(pixels, 0, (size_t)width * height * texelSize(format, type));
+}
+
+// Shaders and programs - sources are kept until the program they're attached to is linked
+static GLuint APIENTRY nullCreateShader(GLenum type) { record("glCreateShader", 0, { type }); shaderTypes[nextName] = type; return nextName++; }
+static GLuint APIENTRY nullCreateProgram() { record("glCreateProgram", 0, {}); return nextName++; }
+static void APIENTRY nullDeleteShader(GLuint shader) { record("glDeleteShader", 0, { shader }); shaderTypes.erase(shader); shaderSources.erase(shader); }
+static void APIENTRY nullCompileShader(GLuint shader) { record("glCompileShader", 0, { shader }); }
+static void APIENTRY nullValidateProgram(GLuint program) { record("glValidateProgram", 0, { program }); }
+static void APIENTRY nullUseProgram(GLuint program) { recordState("glUseProgram", { program }); }
+
+static void APIENTRY nullDeleteProgram(GLuint program)
+{
+	record("glDeleteProgram", 0, { program });
+
+	attachedShaders.erase(program);
+	programs.erase(program);
+}
+
+static void APIENTRY nullShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+{
+	record("glShaderSource", 0, { shader, (std::uint64_t)count });
+
+	std::string& source = shaderSources[shader];
+
+	source.clear();
+
+	for (GLsizei i = 0; i < count; i++)
+		source += (length != NULL && length[i] >= 0) ? std::string(string[i], length[i]) : std::string(string[i]);
+}
+
+static void APIENTRY nullAttachShader(GLuint program, GLuint shader)
+{
+	record("glAttachShader", 0, { program, shader });
+
+	attachedShaders[program].push_back(shader);
+}
+
+static void APIENTRY nullDetachShader(GLuint program, GLuint shader)
+{
+	record("glDetachShader", 0, { program, shader });
+
+	std::vector<GLuint>& attached = attachedShaders[program];
+
+	attached.erase(std::remove(attached.begin(), attached.end(), shader), attached.end());
+}
+
+static void APIENTRY nullLinkProgram(GLuint program)
+{
+	record("glLinkProgram", 0, { program });
+
+	NullProgram linked;
+
+	for (GLuint shader : attachedShaders[program])
+		scan(shaderSources[shader], shaderTypes[shader] == GL_VERTEX_SHADER, linked);
+
+	programs[program] = linked;
+}
+
+static void APIENTRY nullGetShaderiv(GLuint shader, GLenum pname, GLint* params)
+{
+	record("glGetShaderiv", 0, { shader, pname });
+
+	*params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+// The longest name in a table, counting its terminator
+template<typename T>
+static GLint maxNameLength(const std::vector<T>& table)
+{
+	GLint length = 0;
+
+	for (const T& entry : table)
+		length = std::max(length, (GLint)entry.name.size() + 1);
+
+	return length;
+}
+
+static void APIENTRY nullGetProgramiv(GLuint program, GLenum pname, GLint* params)
+{
+	record("glGetProgramiv", 0, { program, pname });
+
+	const NullProgram& linked = programs[program];
+
+	switch (pname)
+	{
+	case GL_LINK_STATUS: case GL_VALIDATE_STATUS: *params = GL_TRUE; break;
+	case GL_ACTIVE_UNIFORMS: *params = (GLint)linked.uniforms.size(); break;
+	case GL_ACTIVE_UNIFORM_MAX_LENGTH: *params = maxNameLength(linked.uniforms); break;
+	case GL_ACTIVE_ATTRIBUTES: *params = (GLint)linked.attributes.size(); break;
+	case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH: *params = maxNameLength(linked.attributes); break;
+	case GL_ACTIVE_UNIFORM_BLOCKS: *params = (GLint)linked.blocks.size(); break;
+	case GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH: *params = maxNameLength(linked.blocks); break;
+	default: *params = 0; break;
+	}
+}
+
+static void APIENTRY nullGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	record("glGetShaderInfoLog", 0, { shader });
+
+	if (length != NULL)
+		*length = 0;
+	if (bufSize > 0)
+		infoLog[0] = '\0';
+}
+
+static void APIENTRY nullGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	record("glGetProgramInfoLog", 0, { program });
+
+	if (length != NULL)
+		*length = 0;
+	if (bufSize > 0)
+		infoLog[0] = '\0';
+}
+
+// Copies a name out the way every glGetActive* call does, cut short to fit the buffer
+static void copyName(const std::string& name, GLsizei bufSize, GLsizei* length, GLchar* buffer)
+{
+	GLsizei copied = bufSize > 0 ? std::min((GLsizei)name.size(), bufSize - 1) : 0;
+
+	if (bufSize > 0)
+	{
+		memcpy(buffer, name.data(), copied);
+		buffer[copied] = '\0';
+	}
+
+	if (length != NULL)
+		*length = copied;
+}
+
+static void APIENTRY nullGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+{
+	record("glGetActiveUniform", 0, { program, index });
+
+	const NullResource& uniform = programs[program].uniforms.at(index);
+
+	*size = uniform.size;
+	*type = uniform.type;
+	copyName(uniform.name, bufSize, length, name);
+}
+
+static void APIENTRY nullGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+{
+	record("glGetActiveAttrib", 0, { program, index });
+
+	const NullResource& attribute = programs[program].attributes.at(index);
+
+	*size = attribute.size;
+	*type = attribute.type;
+	copyName(attribute.name, bufSize, length, name);
+}
+
+static void APIENTRY nullGetActiveUniformsiv(GLuint program, GLsizei count, const GLuint* indices, GLenum pname, GLint* params)
+{
+	record("glGetActiveUniformsiv", 0, { program, (std::uint64_t)count, pname });
+
+	const NullProgram& linked = programs[program];
+
+	for (GLsizei i = 0; i < count; i++)
+	{
+		const NullResource& uniform = linked.uniforms.at(indices[i]);
+
+		switch (pname)
+		{
+		case GL_UNIFORM_TYPE: params[i] = (GLint)uniform.type; break;
+		case GL_UNIFORM_SIZE: params[i] = uniform.size; break;
+		case GL_UNIFORM_NAME_LENGTH: params[i] = (GLint)uniform.name.size() + 1; break;
+		case GL_UNIFORM_BLOCK_INDEX: params[i] = uniform.blockIndex; break;
+		case GL_UNIFORM_OFFSET: params[i] = uniform.offset; break;
+		default: params[i] = 0; break;
+		}
+	}
+}
+
+static void APIENTRY nullGetActiveUniformBlockName(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLchar* name)
+{
+	record("glGetActiveUniformBlockName", 0, { program, index });
+
+	copyName(programs[program].blocks.at(index).name, bufSize, length, name);
+}
+
+static void APIENTRY nullGetActiveUniformBlockiv(GLuint program, GLuint index, GLenum pname, GLint* params)
+{
+	record("glGetActiveUniformBlockiv", 0, { program, index, pname });
+
+	const NullProgram& linked = programs[program];
+	const NullBlock& block = linked.blocks.at(index);
+
+	switch (pname)
+	{
+	case GL_UNIFORM_BLOCK_BINDING: *params = (GLint)block.binding; break;
+	case GL_UNIFORM_BLOCK_DATA_SIZE: *params = block.dataSize; break;
+	case GL_UNIFORM_BLOCK_NAME_LENGTH: *params = (GLint)block.name.size() + 1; break;
+	case GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS:
+		*params = (GLint)std::count_if(linked.uniforms.begin(), linked.uniforms.end(), [&](const NullResource& u) { return u.blockIndex == (GLint)index; });
+		break;
+	case GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES:
+		for (size_t i = 0; i < linked.uniforms.size(); i++)
+		{
+			if (linked.uniforms[i].blockIndex == (GLint)index)
+				*params++ = (GLint)i;
+		}
+		break;
+	default: *params = 0; break;
+	}
+}
+
+// Looks a name up in a program's table - "name" and "name[0]" both find an array
+static const NullResource* findResource(const std::vector<NullResource>& table, const std::string& name)
+{
+	for (const NullResource& resource : table)
+	{
+		if (resource.name == name || resource.name == name + "[0]")
+			return &resource;
+	}
+
+	return NULL;
+}
+
+// Every declared uniform outside a block has a stable location per name, shared by all programs
+static GLint location(const std::string& name)
+{
+	auto found = locations.find(name);
+
+	if (found != locations.end())
+		return found->second;
+
+	GLint l = (GLint)locations.size();
+	locations[name] = l;
+
+	return l;
+}
+
+static GLint APIENTRY nullGetUniformLocation(GLuint program, const GLchar* name)
+{
+	record("glGetUniformLocation", 0, { program });
+
+	const NullResource* uniform = findResource(programs[program].uniforms, name);
+
+	if (uniform == NULL || uniform->blockIndex != -1)
+		return -1;
+
+	return location(uniform->name);
+}
+
+static GLint APIENTRY nullGetAttribLocation(GLuint program, const GLchar* name)
+{
+	record("glGetAttribLocation", 0, { program });
+
+	const NullResource* attribute = findResource(programs[program].attributes, name);
+
+	if (attribute == NULL)
+		return -1;
+
+	return attribute->location != -1 ? attribute->location : location(attribute->name) % 16;
+}
+
+static GLuint APIENTRY nullGetUniformBlockIndex(GLuint program, const GLchar* name)
+{
+	record("glGetUniformBlockIndex", 0, { program });
+
+	const std::vector<NullBlock>& blocks = programs[program].blocks;
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].name == name)
+			return (GLuint)i;
+	}
+
+	return GL_INVALID_INDEX;
+}
+
+static void APIENTRY nullUniformBlockBinding(GLuint program, GLuint index, GLuint binding)
+{
+	record("glUniformBlockBinding", 0, { program, index, binding });
+
+	std::vector<NullBlock>& blocks = programs[program].blocks;
+
+	if (index < blocks.size())
+		blocks[index].binding = binding;
+}
+
+// Uniforms
+static void APIENTRY nullUniform1i(GLint location, GLint v0) { recordUniform("glUniform1i", location); }
+static void APIENTRY nullUniform1f(GLint location, GLfloat v0) { recordUniform("glUniform1f", location); }
+static void APIENTRY nullUniform2f(GLint location, GLfloat v0, GLfloat v1) { recordUniform("glUniform2f", location); }
+static void APIENTRY nullUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { recordUniform("glUniform3f", location); }
+static void APIENTRY nullUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { recordUniform("glUniform4f", location); }
+static void APIENTRY nullUniform2fv(GLint location, GLsizei count, const GLfloat* value) { recordUniform("glUniform2fv", location); }
+static void APIENTRY nullUniform3fv(GLint location, GLsizei count, const GLfloat* value) { recordUniform("glUniform3fv", location); }
+static void APIENTRY nullUniform4fv(GLint location, GLsizei count, const GLfloat* value) { recordUniform("glUniform4fv", location); }
+static void APIENTRY nullUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { recordUniform("glUniformMatrix2fv", location); }
+static void APIENTRY nullUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { recordUniform("glUniformMatrix3fv", location); }
+static void APIENTRY nullUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { recordUniform("glUniformMatrix4fv", location); }
+
+// Draws
+static void APIENTRY nullDrawArrays(GLenum mode, GLint first, GLsizei count) { recordDraw("glDrawArrays", { mode, (std::uint64_t)first, (std::uint64_t)count }); }
+static void APIENTRY nullDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) { recordDraw("glDrawElements", { mode, (std::uint64_t)count, type, bitsOf(indices) }); }
+
+static void APIENTRY nullDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+{
+	recordDraw("glDrawElementsInstanced", { mode, (std::uint64_t)count, type, bitsOf(indices), (std::uint64_t)instances });
+}
+
+static void APIENTRY nullDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex)
+{
+	recordDraw("glDrawElementsBaseVertex", { mode, (std::uint64_t)count, type, bitsOf(indices), (std::uint64_t)baseVertex });
+}
+
+// Sync - there is no GPU to wait for
+static GLsync APIENTRY nullFenceSync(GLenum condition, GLbitfield flags) { record("glFenceSync", 0, { condition }); return (GLsync)(uintptr_t)nextName++; }
+static void APIENTRY nullDeleteSync(GLsync sync) { record("glDeleteSync", 0, { bitsOf(sync) }); }
+static GLenum APIENTRY nullClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) { record("glClientWaitSync", 0, { bitsOf(sync), flags, timeout }); return GL_ALREADY_SIGNALED; }
+
+// Queries - results are available straight away and took no time
+static void APIENTRY nullGenQueries(GLsizei n, GLuint* ids) { record("glGenQueries", 0, { (std::uint64_t)n }); generate(n, ids); }
+static void APIENTRY nullDeleteQueries(GLsizei n, const GLuint* ids) { record("glDeleteQueries", 0, { (std::uint64_t)n }); }
+static void APIENTRY nullBeginQuery(GLenum target, GLuint id) { record("glBeginQuery", 0, { target, id }); }
+static void APIENTRY nullEndQuery(GLenum target) { record("glEndQuery", 0, { target }); }
+
+static void APIENTRY nullGetQueryObjectiv(GLuint id, GLenum pname, GLint* params)
+{
+	record("glGetQueryObjectiv", 0, { id, pname });
+
+	*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void APIENTRY nullGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+{
+	record("glGetQueryObjectui64v", 0, { id, pname });
+
+	*params = 0;
+}
+
+// ---------- Loader ----------
+
+static void* nullGetProcAddress(const char* name)
+{
+	static const std::map<std::string, void*> stubs = {
+		{ "glGetString", (void*)nullGetString },
+		{ "glGetStringi", (void*)nullGetStringi },
+		{ "glGetIntegerv", (void*)nullGetIntegerv },
+		{ "glViewport", (void*)nullViewport },
+		{ "glClearColor", (void*)nullClearColor },
+		{ "glClear", (void*)nullClear },
+		{ "glEnable", (void*)nullEnable },
+		{ "glDisable", (void*)nullDisable },
+		{ "glBlendFunc", (void*)nullBlendFunc },
+		{ "glPixelStorei", (void*)nullPixelStorei },
+		{ "glGenBuffers", (void*)nullGenBuffers },
+		{ "glDeleteBuffers", (void*)nullDeleteBuffers },
+		{ "glBindBuffer", (void*)nullBindBuffer },
+		{ "glBindBufferBase", (void*)nullBindBufferBase },
+		{ "glBufferData", (void*)nullBufferData },
+		{ "glBufferSubData", (void*)nullBufferSubData },
+		{ "glMapBufferRange", (void*)nullMapBufferRange },
+		{ "glUnmapBuffer", (void*)nullUnmapBuffer },
+		{ "glGenVertexArrays", (void*)nullGenVertexArrays },
+		{ "glDeleteVertexArrays", (void*)nullDeleteVertexArrays },
+		{ "glBindVertexArray", (void*)nullBindVertexArray },
+		{ "glEnableVertexAttribArray", (void*)nullEnableVertexAttribArray },
+		{ "glVertexAttribDivisor", (void*)nullVertexAttribDivisor },
+		{ "glVertexAttribPointer", (void*)nullVertexAttribPointer },
+		{ "glVertexAttribIPointer", (void*)nullVertexAttribIPointer },
+		{ "glGenTextures", (void*)nullGenTextures },
+		{ "glDeleteTextures", (void*)nullDeleteTextures },
+		{ "glActiveTexture", (void*)nullActiveTexture },
+		{ "glBindTexture", (void*)nullBindTexture },
+		{ "glTexParameteri", (void*)nullTexParameteri },
+		{ "glGenerateMipmap", (void*)nullGenerateMipmap },
+		{ "glTexImage2D", (void*)nullTexImage2D },
+		{ "glTexImage3D", (void*)nullTexImage3D },
+		{ "glTexSubImage2D", (void*)nullTexSubImage2D },
+		{ "glReadPixels", (void*)nullReadPixels },
+		{ "glTexBuffer", (void*)nullTexBuffer },
+		{ "glCreateShader", (void*)nullCreateShader },
+		{ "glCreateProgram", (void*)nullCreateProgram },
+		{ "glDeleteShader", (void*)nullDeleteShader },
+		{ "glDeleteProgram", (void*)nullDeleteProgram },
+		{ "glShaderSource", (void*)nullShaderSource },
+		{ "glCompileShader", (void*)nullCompileShader },
+		{ "glAttachShader", (void*)nullAttachShader },
+		{ "glDetachShader", (void*)nullDetachShader },
+		{ "glLinkProgram", (void*)nullLinkProgram },
+		{ "glValidateProgram", (void*)nullValidateProgram },
+		{ "glUseProgram", (void*)nullUseProgram },
+		{ "glGetShaderiv", (void*)nullGetShaderiv },
+		{ "glGetProgramiv", (void*)nullGetProgramiv },
+		{ "glGetShaderInfoLog", (void*)nullGetShaderInfoLog },
+		{ "glGetProgramInfoLog", (void*)nullGetProgramInfoLog },
+		{ "glGetActiveUniform", (void*)nullGetActiveUniform },
+		{ "glGetActiveAttrib", (void*)nullGetActiveAttrib },
+		{ "glGetActiveUniformsiv", (void*)nullGetActiveUniformsiv },
+		{ "glGetActiveUniformBlockName", (void*)nullGetActiveUniformBlockName },
+		{ "glGetActiveUniformBlockiv", (void*)nullGetActiveUniformBlockiv },
+		{ "glGetUniformLocation", (void*)nullGetUniformLocation },
+		{ "glGetAttribLocation", (void*)nullGetAttribLocation },
+		{ "glGetUniformBlockIndex", (void*)nullGetUniformBlockIndex },
+		{ "glUniformBlockBinding", (void*)nullUniformBlockBinding },
+		{ "glUniform1i", (void*)nullUniform1i },
+		{ "glUniform1f", (void*)nullUniform1f },
+		{ "glUniform2f", (void*)nullUniform2f },
+		{ "glUniform3f", (void*)nullUniform3f },
+		{ "glUniform4f", (void*)nullUniform4f },
+		{ "glUniform2fv", (void*)nullUniform2fv },
+		{ "glUniform3fv", (void*)nullUniform3fv },
+		{ "glUniform4fv", (void*)nullUniform4fv },
+		{ "glUniformMatrix2fv", (void*)nullUniformMatrix2fv },
+		{ "glUniformMatrix3fv", (void*)nullUniformMatrix3fv },
+		{ "glUniformMatrix4fv", (void*)nullUniformMatrix4fv },
+		{ "glDrawArrays", (void*)nullDrawArrays },
+		{ "glDrawElements", (void*)nullDrawElements },
+		{ "glDrawElementsInstanced", (void*)nullDrawElementsInstanced },
+		{ "glDrawElementsBaseVertex", (void*)nullDrawElementsBaseVertex },
+		{ "glFenceSync", (void*)nullFenceSync },
+		{ "glDeleteSync", (void*)nullDeleteSync },
+		{ "glClientWaitSync", (void*)nullClientWaitSync },
+		{ "glGenQueries", (void*)nullGenQueries },
+		{ "glDeleteQueries", (void*)nullDeleteQueries },
+		{ "glBeginQuery", (void*)nullBeginQuery },
+		{ "glEndQuery", (void*)nullEndQuery },
+		{ "glGetQueryObjectiv", (void*)nullGetQueryObjectiv },
+		{ "glGetQueryObjectui64v", (void*)nullGetQueryObjectui64v },
+	};
+
+	auto found = stubs.find(name);
+
+	return found != stubs.end() ? found->second : NULL;
+}
+
+bool loadNullGL()
+{
+	if (!gladLoadGLLoader((GLADloadproc)nullGetProcAddress))
+		return false;
+
+	loaded = true;
+
+	// Loading isn't part of any frame
+	nullGLEndFrame();
+
+#ifdef DEBUG_ON
+	printf("Null GL backend loaded - no GPU work will be done\n");
+#endif
+
+	return true;
+}
+
+bool isNullGLLoaded()
+{
+	return loaded;
+}
+
+NullGLStats nullGLEndFrame()
+{
+	NullGLStats stats = current;
+
+	current = {};
+
+	lastCalls.swap(calls);
+	calls.clear();
+
+	return stats;
+}
+
+void nullGLWriteTrace(FILE* file)
+{
+	for (const NullGLCall& call : lastCalls)
+	{
+		fprintf(file, "%s(", call.name);
+
+		for (int i = 0; i < call.argCount; i++)
+		{
+			fprintf(file, i == 0 ? "0x%llx" : ", 0x%llx", (unsigned long long)call.args[i]);
+		}
+
+		if (call.bytes > 0)
+			fprintf(file, ") %zu bytes\n", call.bytes);
+		else
+			fprintf(file, ")\n");
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <cstdint>
+
+// Counts for one frame of calls made against the null backend
+struct NullGLStats {
+
+	int calls;
+	int drawCalls;
+
+	// Binds, enables and other context state changes
+	int stateChanges;
+	int uniformSets;
+
+	// Bytes handed to buffer and texture uploads
+	size_t bytesUploaded;
+};
+
+// One recorded call - integer arguments as given, floats by value, pointers by address
+struct NullGLCall {
+
+	const char* name;
+
+	int argCount;
+	std::uint64_t args[6];
+
+	size_t bytes;
+};
+
+// Points every glad function the engine uses at a stub that records the call instead of reaching a driver,
+// so the renderers can run with no GPU, display or context. Functions without a stub are left NULL.
+// Object names, uniform locations and queries get plausible answers - shaders always compile and link, and
+// the active uniforms, attributes and blocks a program reports are the ones its sources declare.
+bool loadNullGL();
+
+bool isNullGLLoaded();
+
+// Closes the current frame - returns its counts and keeps its call log for nullGLWriteTrace()
+NullGLStats nullGLEndFrame();
+
+// Writes the call log of the last completed frame, one call per line
+void nullGLWriteTrace(FILE* file);
@@ -6,11 +6,36 @@
 #include <string>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <map>
 
 namespace fs = std::experimental::filesystem;
 
 #include "Dungeon.h"
 #include "ShaderProgram.h"
+#include "ShaderVariants.h"
+#include "TileRenderer.h"
+#include "ChunkRenderer.h"
+#include "TileMapRenderer.h"
+#include "LayerRenderer.h"
+#include "SpriteBatch.h"
+#include "StreamBuffer.h"
+#include "RenderCommandList.h"
+#include "RenderThread.h"
+#include "FrameUniforms.h"
+#include "NullGL.h"
+#include "SoftwareRenderer.h"
+#include "PngWriter.h"
+#include "FrameProfiler.h"
+#include "LightGrid.h"
+#include "Minimap.h"
+#include "LodRenderer.h"
+#include "TileAnimations.h"
+#include "ProgramBinaryCache.h"
+#include "TextureCache.h"
+#include "TextureUploader.h"
 
 // MUST only be done ONCE 
 #ifndef STB_IMAGE_IMPLEMENTATION
@@ -29,7 +54,137 @@ float lastFrame = 0.0f; // Time of last frame
 GLFWwindow* window;
 
 Dungeon* dungeon;
-ShaderProgram* shader;
+
+// Variants of the per-tile program, and of the instanced one shared by the tile, chunk and layer renderers
+ShaderVariants* tileShaders;
+ShaderVariants* instancedShaders;
+
+// The per-tile program last drawn with, and its uniforms - resolved again whenever the variant changes
+ShaderProgram* tileProgram = NULL;
+Uniform<glm::vec2> offsetUniform;
+Uniform<glm::mat4> frameUniform;
+
+// Set once the dungeon is generated if any floor tile isn't plain white - colours never change after that
+bool tintedTiles = false;
+
+TileRenderer* tileRenderer;
+ChunkRenderer* chunkRenderer;
+TileMapRenderer* tileMapRenderer;
+LayerRenderer* layerRenderer;
+SpriteBatch* spriteBatch;
+StreamBuffer* streamBuffer;
+RenderThread* renderThread;
+FrameUniformBuffer* frameUniforms;
+FrameProfiler* profiler;
+LightGrid* lightGrid;
+Minimap* minimap;
+LodRenderer* lodRenderer;
+TileAnimations* tileAnimations;
+TextureCache* textureCache;
+ProgramBinaryCache* programCache;
+TextureUploader* textureUploader;
+
+// Pass --single-threaded to replay the command list inline instead of on the render thread
+bool singleThreaded = false;
+
+// Pass --null-gl to run headless, with every GL call recorded instead of executed. Runs for --frames
+// frames (default HEADLESS_FRAMES) and reports per-frame averages, --gl-trace <file> dumps the last frame's calls.
+#define HEADLESS_FRAMES 600
+
+bool nullBackend = false;
+int benchmarkFrames = 0;
+const char* traceFile = NULL;
+
+// Pass --uniform-bench to time setting the per-tile uniforms for every tile in the map, by name and through
+// handles, on the null backend - then exit
+#define UNIFORM_BENCH_FRAMES 50
+
+bool uniformBench = false;
+
+// Runs with a frame count step a fixed time per frame, so the same frames are drawn every run
+#define FIXED_TIME_STEP (1.0f / 60.0f)
+
+// Seconds of game time - drives animation, and is the wall clock unless the step is fixed
+float simulationTime = 0.0f;
+
+// Clock of the last frame drawn, to tell whether a visible animation has moved on since
+float drawnTime = 0.0f;
+
+// Pass --software to draw the map and sprites on the CPU, split into --threads N bands (0 = one per core).
+// The GL only presents the result.
+bool softwareBackend = false;
+int softwareThreads = 0;
+SoftwareRenderer* softwareRenderer = NULL;
+
+// Pass --dump <file.png> with --frames to save the last frame, for comparing the software and GL output
+const char* dumpFile = NULL;
+bool captureFrame = false;
+std::vector<unsigned char> dumpPixels;
+
+// With a window, frames are only drawn when something could have changed - otherwise the loop sleeps in
+// glfwWaitEventsTimeout() and the last frame stays on screen. Pass --always-redraw to draw every frame.
+#define IDLE_WAIT_TIMEOUT 0.5
+
+bool idleRedraw = true;
+
+// Set when the window needs its contents drawn again, e.g. after being uncovered
+bool redrawRequested = true;
+
+// Pass --profile <file.csv> to save the per-stage CPU and GPU times of the last PROFILER_HISTORY frames on exit
+const char* profileFile = NULL;
+
+// Decoded textures and their mip chains are kept in TEXTURE_CACHE_DIR - pass --no-texture-cache to decode every run
+#define TEXTURE_CACHE_DIR "./res/cache/"
+
+bool useTextureCache = true;
+
+// Linked shader programs are kept in SHADER_CACHE_DIR when the driver can hand them back - pass
+// --no-shader-cache to compile from source every run
+#define SHADER_CACHE_DIR "./res/cache/shaders/"
+
+bool useShaderCache = true;
+
+// Which path render() draws the map with - switch at runtime with F1-F4
+enum class RenderMode
+{
+	PER_TILE, INSTANCED, CHUNKED, TILE_MAP
+};
+
+RenderMode renderMode = RenderMode::CHUNKED;
+
+const char* renderModeName(RenderMode mode)
+{
+	switch (mode)
+	{
+	case RenderMode::PER_TILE:
+		return "per tile";
+	case RenderMode::INSTANCED:
+		return "instanced";
+	case RenderMode::CHUNKED:
+		return "chunked";
+	case RenderMode::TILE_MAP:
+		return "tile map";
+	}
+	return "";
+}
+
+// Pass --lights N for N lights wandering round the screen plus a torch on the player - F6 toggles LIGHT_DEFAULT_COUNT
+#define LIGHT_DEFAULT_COUNT 256
+#define LIGHT_AMBIENT 0.3f
+
+int lightCount = 0;
+std::vector<PointLight> lights;
+std::vector<glm::vec2> lightAnchors;
+
+// Whole-dungeon overview in the corner, filled in as the player explores - toggle with F7
+bool showMinimap = true;
+
+// Per frame draw call count, for comparing render modes
+int drawCalls = 0;
+
+// Fills the screen with SPRITE_STRESS_COUNT moving sprites to measure the sprite batch - toggle with F5
+bool spriteStress = false;
+std::vector<glm::vec2> stressSprites;
 
 const float vertices[] = {
 	// positions									 // texture coords
@@ -56,6 +211,13 @@ Location location;
 Camera camera;
 glm::ivec2 cameraMovement;
 
+// Pixels per world unit - +/- halve and double it between ZOOM_MIN and ZOOM_MAX, or pass --zoom z.
+// Below LOD_ZOOM_THRESHOLD the map is drawn from the LOD pyramid. The software renderer always draws at 1.
+#define ZOOM_MIN (1.0f / 64.0f)
+#define ZOOM_MAX 4.0f
+
+float zoom = 1.0f;
+
 glm::ivec2 movementVector;
 
 float movementSpeed = 12.0f;
@@ -67,7 +229,19 @@ unsigned int EBO;
 
 std::vector<unsigned int> textures;
 
+// Queued by initTextures(), set up by finishTextures() once they're in
+std::vector<AsyncTexture*> pendingTextures;
+
+#ifdef DEBUG_ON
+double texturesQueuedAt;
+#endif
+
 unsigned int mapTexture;
+// map_x split into one GL_TEXTURE_2D_ARRAY layer per frame
+unsigned int mapArrayTexture;
+
+unsigned int spriteTexture;
+int spriteWidth, spriteHeight;
 int tileCountX, tileCountY;
 double tileScaleX, tileScaleY;
 int totalFrames;
@@ -76,6 +250,10 @@ std::vector<glm::mat4> tileFrameTransforms;
 
 bool updatedCameraMovement = true;
 
+// Set by the framebuffer callback and recorded at the start of the next frame, since the context may be on the render thread
+bool viewportChanged = false;
+int viewportWidth = WIDTH, viewportHeight = HEIGHT;
+
 static bool endsWith(const std::string& str, const std::string& suffix)
 {
 	return str.size() >= suffix.size() && 0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
@@ -89,80 +267,138 @@ glm::mat4 calcTileFrameTransform(int id)
 	return mapScale;
 }
 
-unsigned int loadTexture(std::string path)
+// Copies every MAP_TILE_DIM square of the atlas into its own array layer, so tiles are addressed by a
+// single layer index and mipmaps are built per tile without bleeding into their neighbours
+unsigned int createTileArray(const unsigned char* data, int width, int height)
 {
-	unsigned int tex;
+	int maxLayers;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	if (totalFrames > maxLayers)
+	{
+		printf("Atlas has %d frames but only %d array layers are supported - frames past the limit will repeat the last layer\n", totalFrames, maxLayers);
+	}
 
-	stbi_set_flip_vertically_on_load(true);
+	int layers = std::min(totalFrames, maxLayers);
 
-	int width, height, nrChannels;
-	unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-	
-	if (data)
+	// Reorder so each frame's rows are contiguous - frames run left to right, bottom to top like calcTileFrameTransform()
+	const int rowBytes = MAP_TILE_DIM * 4;
+	std::vector<unsigned char> split(layers * MAP_TILE_DIM * rowBytes);
+
+	for (int i = 0; i < layers; i++)
 	{
-		glGenTextures(1, &tex);
+		int originX = (i % tileCountX) * MAP_TILE_DIM;
+		int originY = (i / tileCountX) * MAP_TILE_DIM;
 
-		if (path.find("map_x") != std::string::npos)
+		for (int row = 0; row < MAP_TILE_DIM; row++)
 		{
-			tileCountX = width / MAP_TILE_DIM;
-			tileCountY = height / MAP_TILE_DIM;
+			memcpy(&split[((i * MAP_TILE_DIM) + row) * rowBytes], &data[(((originY + row) * width) + originX) * 4], rowBytes);
+		}
+	}
+
+	unsigned int tex;
+	glGenTextures(1, &tex);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, MAP_TILE_DIM, MAP_TILE_DIM, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, split.data());
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return tex;
+}
+
+// Sorts out what a loaded texture is for, and builds everything that needs its texels on the CPU
+unsigned int setupTexture(AsyncTexture* loaded)
+{
+	if (loaded->failed)
+		return 0;
+
+	unsigned int tex = loaded->texture;
+
+	int width = loaded->width;
+	int height = loaded->height;
+
+	// Always RGBA - level 0 of the chain
+	const unsigned char* data = loaded->data;
+
+	const std::string& path = loaded->path;
+
+	if (path.find("map_x") != std::string::npos)
+	{
+		tileCountX = width / MAP_TILE_DIM;
+		tileCountY = height / MAP_TILE_DIM;
 
 #ifdef DEBUG_ON
-			printf("Width=%d, Height=%d : nX=%d, nY=%d\n", width, height, tileCountX, tileCountY);
+		printf("Width=%d, Height=%d : nX=%d, nY=%d\n", width, height, tileCountX, tileCountY);
 #endif
 
-			tileScaleX = 1.0 / (double)(tileCountX);
-			tileScaleY = 1.0 / (double)(tileCountY);
+		tileScaleX = 1.0 / (double)(tileCountX);
+		tileScaleY = 1.0 / (double)(tileCountY);
 
-			totalFrames = tileCountX * tileCountY;
+		totalFrames = tileCountX * tileCountY;
 
 #ifdef DEBUG_ON
-			printf("Calculating transforms for %d tiles.... Scale: %f, %f\n", totalFrames, tileScaleX, tileScaleY);
+		printf("Calculating transforms for %d tiles.... Scale: %f, %f\n", totalFrames, tileScaleX, tileScaleY);
 #endif
 
-			for (int i = 0; i < totalFrames; i++)
-			{
-				tileFrameTransforms.push_back(calcTileFrameTransform(i));
-			}
-			mapTexture = tex;
+		for (int i = 0; i < totalFrames; i++)
+		{
+			tileFrameTransforms.push_back(calcTileFrameTransform(i));
+		}
+		mapTexture = tex;
 
 #ifdef DEBUG_ON
-			printf("Map texture bound to %d, %d frames....\n", mapTexture, tileFrameTransforms.size());
+		printf("Map texture bound to %d, %d frames....\n", mapTexture, tileFrameTransforms.size());
+
+		double splitStart = glfwGetTime();
 #endif
-		}
+		mapArrayTexture = createTileArray(data, width, height);
 
-		glBindTexture(GL_TEXTURE_2D, tex);
+		minimap->setPalette(data, width, tileCountX, totalFrames);
+		lodRenderer->setAtlas(data, width, tileCountX, totalFrames);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (softwareRenderer != NULL)
+		{
+			softwareRenderer->addTexture(tex, width, height, data);
+			softwareRenderer->setTileAtlas(tex, tileCountX, totalFrames);
+		}
 
-		totalTexturesLoaded++;
-	}
-	else
-	{
 #ifdef DEBUG_ON
-		printf("FAILED TO LOAD TEXTURE\n");
+		printf("%s map in %.2f ms off the main thread, split into %d array layers in %.2f ms\n",
+			loaded->cached ? "Mapped the cached" : "Decoded the", 1000.0 * loaded->decodeTime, totalFrames, 1000.0 * (glfwGetTime() - splitStart));
 #endif
-		return 0;
 	}
 
-	stbi_image_free(data);
+	if (path.find("sprite") != std::string::npos)
+	{
+		spriteTexture = tex;
+		spriteWidth = width;
+		spriteHeight = height;
+
+		if (softwareRenderer != NULL)
+			softwareRenderer->addTexture(tex, width, height, data);
+	}
+
+	totalTexturesLoaded++;
 
 	return tex;
 }
 
+// Queues every texture for decoding on the uploader's worker, so startup can carry on meanwhile
 void initTextures(std::string path)
 {
 #ifdef DEBUG_ON
 	printf("Loading textures...\n");
-#endif
 
-	int count = 0;
+	texturesQueuedAt = glfwGetTime();
+#endif
 
 	for (auto & dir : fs::recursive_directory_iterator(path))
 	{
@@ -175,13 +411,42 @@ void initTextures(std::string path)
 				continue;
 			
 #ifdef DEBUG_ON
-			printf("Loading texture: ");
+			printf("Queueing texture: ");
 			printf(str.c_str());
 			printf("\n");
 #endif
-			textures.push_back(loadTexture(dir.path().string()));
+			// The CPU copy feeds the tile array, the minimap, the LOD pyramid and the software renderer
+			pendingTextures.push_back(textureUploader->load(str, true));
 		}
 	}
+
+	// Only starts the decodes on the worker, so they overlap the rest of startup. The pixel buffers are mapped
+	// by a later poll once a file is decoded, which during startup means finishTextures().
+	textureUploader->poll();
+}
+
+// Waits for the queued textures - only blocks for what's left after the rest of startup
+void finishTextures()
+{
+#ifdef DEBUG_ON
+	double waitStart = glfwGetTime();
+#endif
+
+	textureUploader->finish();
+
+#ifdef DEBUG_ON
+	printf("Waited %.2f ms for textures, %.2f ms after queueing them\n", 1000.0 * (glfwGetTime() - waitStart), 1000.0 * (glfwGetTime() - texturesQueuedAt));
+#endif
+
+	for (AsyncTexture* loaded : pendingTextures)
+	{
+		textures.push_back(setupTexture(loaded));
+
+		textureUploader->releasePixels(loaded);
+	}
+
+	pendingTextures.clear();
+
 #ifdef DEBUG_ON
 	printf("Loaded %d textures...\n", textures.size());
 #endif
@@ -189,7 +454,59 @@ void initTextures(std::string path)
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) 
 { 
-	glViewport(0, 0, width, height);
+	viewportWidth = width;
+	viewportHeight = height;
+
+	viewportChanged = true;
+}
+
+void window_refresh_callback(GLFWwindow* window)
+{
+	redrawRequested = true;
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS)
+		return;
+
+	bool zoomIn = (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) && softwareRenderer == NULL;
+	bool zoomOut = (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) && softwareRenderer == NULL;
+
+	// The per-tile and instanced paths only keep the visible set up to date while they're in use
+	if (key == GLFW_KEY_F1 || key == GLFW_KEY_F2 || zoomIn || zoomOut)
+		updatedCameraMovement = true;
+
+	// The F keys change how the view is drawn, so it has to be drawn again even if nothing moved
+	if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F7)
+		redrawRequested = true;
+
+	if (key == GLFW_KEY_F1)
+		renderMode = RenderMode::PER_TILE;
+
+	if (key == GLFW_KEY_F2)
+		renderMode = RenderMode::INSTANCED;
+
+	if (key == GLFW_KEY_F3)
+		renderMode = RenderMode::CHUNKED;
+
+	if (key == GLFW_KEY_F4)
+		renderMode = RenderMode::TILE_MAP;
+
+	if (key == GLFW_KEY_F5)
+		spriteStress = !spriteStress;
+
+	if (key == GLFW_KEY_F6)
+		lightCount = lightCount > 0 ? 0 : LIGHT_DEFAULT_COUNT;
+
+	if (key == GLFW_KEY_F7)
+		showMinimap = !showMinimap;
+
+	if (zoomIn)
+		zoom = std::min(zoom * 2.0f, ZOOM_MAX);
+
+	if (zoomOut)
+		zoom = std::max(zoom * 0.5f, ZOOM_MIN);
 }
 
 void moveCamera(int x, int y)
@@ -213,6 +530,15 @@ void moveCamera(glm::ivec2 moveDir)
 
 void processInput(GLFWwindow *window)
 {
+	// Headless runs pan steadily, so benchmarks exercise scrolling
+	if (window == NULL)
+	{
+		movementVector.x = 1;
+		movementVector.y = 0;
+		moving = true;
+		return;
+	}
+
 	// ESCAPE!!
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
@@ -255,7 +581,12 @@ int initialise()
 #ifdef DEBUG_ON
 	printf("Initialising GL....\n");
 #endif
-	glfwInit();
+	// Needed headless too, for the timer
+	if (!glfwInit())
+	{
+		printf("Failed to initialise GLFW - Aborting\n");
+		return INITIALISE_FAIL;
+	}
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -265,26 +596,44 @@ int initialise()
 
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-	window = glfwCreateWindow(WIDTH, HEIGHT, "Pikolo", NULL, NULL);
-
-	if (window == NULL)
+	if (nullBackend)
 	{
-		printf("Failed to initialise OpenGL window - Arborting\n");
-		return INITIALISE_FAIL;
+		// No window or context - everything below goes to the recording stubs
+		window = NULL;
+
+		if (!loadNullGL())
+		{
+			printf("Failed to load the null GL backend - Aborting\n");
+			return INITIALISE_FAIL;
+		}
 	}
+	else
+	{
+		window = glfwCreateWindow(WIDTH, HEIGHT, "Pikolo", NULL, NULL);
 
-	glfwMakeContextCurrent(window);
+		if (window == NULL)
+		{
+			printf("Failed to initialise OpenGL window - Arborting\n");
+			return INITIALISE_FAIL;
+		}
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		printf("Failed to initialize GLAD - Aborting\n");
-		return INITIALISE_FAIL;
+		glfwMakeContextCurrent(window);
+
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			printf("Failed to initialize GLAD - Aborting\n");
+			return INITIALISE_FAIL;
+		}
+
+		// This shouldn't do anything, since GLFW_RESIZABLE = FALSE
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+		glfwSetKeyCallback(window, key_callback);
+
+		glfwSetWindowRefreshCallback(window, window_refresh_callback);
 	}
 
 	glViewport(0, 0, WIDTH, HEIGHT);
-
-	// This shouldn't do anything, since GLFW_RESIZABLE = FALSE
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	
 	// tell GLFW to capture our mouse
 	//glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -328,50 +677,297 @@ int initShaders()
 #ifdef DEBUG_ON
 	printf("Generating shader....\n");
 #endif
-	shader = new ShaderProgram();
-
-	shader->initFromFiles("./res/shaders/vertex.vs", "./res/shaders/fragment.fs");	
-	
-	//shader->addUniform("colour");	
-
-	shader->addUniform("transform");
-	shader->addUniform("frame");
+	// Only the variants with every feature on are built here - the rest wait until they're needed
+	tileShaders = new ShaderVariants("./res/shaders/vertex.vs", "./res/shaders/fragment.fs", SHADER_LIGHTING);
+	instancedShaders = new ShaderVariants("./res/shaders/instanced.vs", "./res/shaders/instanced.fs", SHADER_LIGHTING | SHADER_TINT | SHADER_ANIMATED);
+
+	tileRenderer = new TileRenderer(VBO, EBO, instancedShaders);
+	chunkRenderer = new ChunkRenderer(VBO, EBO, instancedShaders);
+	tileMapRenderer = new TileMapRenderer();
+	layerRenderer = new LayerRenderer(VBO, EBO, instancedShaders);
+	streamBuffer = new StreamBuffer(GL_ARRAY_BUFFER, STREAM_BUFFER_FRAME_SIZE);
+	spriteBatch = new SpriteBatch(streamBuffer);
+	frameUniforms = new FrameUniformBuffer();
+	lightGrid = new LightGrid();
+	minimap = new Minimap();
+	lodRenderer = new LodRenderer();
+	tileAnimations = new TileAnimations();
+
+	if (softwareBackend)
+		softwareRenderer = new SoftwareRenderer(WIDTH, HEIGHT, softwareThreads);
 
 	return 1;
 }
 
-glm::mat4 calcTransform(Tile t)
-{	
-	glm::mat4 mat = glm::scale(glm::mat4(1), scale); 
-	mat = glm::translate(mat, glm::vec3((t.posX * TILE_SIZE) - camera.posx, (t.posY * TILE_SIZE) - camera.posy, 0.0f));	 
+glm::mat4 calcView()
+{
+	glm::mat4 mat = glm::scale(glm::mat4(1), glm::vec3(scale.x * zoom, scale.y * zoom, 0.0f));
+	mat = glm::translate(mat, glm::vec3(-camera.posx, -camera.posy, 0.0f));
 	return mat;
 }
 
+// The screen in world units
+Box2d visibleArea()
+{
+	float halfWidth = (WIDTH / 2) / zoom;
+	float halfHeight = (HEIGHT / 2) / zoom;
+
+	return {
+		camera.posx - halfWidth,
+		camera.posx + halfWidth,
+		camera.posy - halfHeight,
+		camera.posy + halfHeight
+	};
+}
+
+// Zoomed far enough out that tiles are drawn from the pre-baked pyramid
+bool usesLod()
+{
+	return softwareRenderer == NULL && zoom < LOD_ZOOM_THRESHOLD;
+}
+
+// The shader features this frame actually needs - the rest are compiled out of the variants drawn with
+unsigned int shaderFeatures()
+{
+	unsigned int features = 0;
+
+	if (lightCount > 0)
+		features |= SHADER_LIGHTING;
+
+	if (tintedTiles)
+		features |= SHADER_TINT;
+
+	if (tileAnimations->getAnimationCount() > 0)
+		features |= SHADER_ANIMATED;
+
+	return features;
+}
+
 std::vector<Tile> visibleTiles;
-void render(float delta)
+int renderMap(RenderCommandList* commands, unsigned int features)
 {
-	glClear(GL_COLOR_BUFFER_BIT);
+	if (renderMode == RenderMode::INSTANCED)
+	{
+		return tileRenderer->render(commands, mapArrayTexture, features);
+	}
 
-	shader->use();
+	if (renderMode == RenderMode::CHUNKED)
+	{
+		return chunkRenderer->render(commands, visibleArea(), mapArrayTexture, features);
+	}
 
-	glBindVertexArray(VAO);
+	if (renderMode == RenderMode::TILE_MAP)
+	{
+		return tileMapRenderer->render(commands, mapArrayTexture);
+	}
+
+	int draws = 0;
 
-	glActiveTexture(GL_TEXTURE0);
+	ShaderProgram* program = tileShaders->get(features);
 
-	glBindTexture(GL_TEXTURE_2D, mapTexture);
+	if (program != tileProgram)
+	{
+		tileProgram = program;
+
+		offsetUniform = program->addUniform<glm::vec2>("offset");
+		frameUniform = program->addUniform<glm::mat4>("frame");
+	}
+
+	commands->useProgram(program->getId());
+
+	commands->bindVertexArray(VAO);
+
+	commands->bindTexture(0, GL_TEXTURE_2D, mapTexture);
 
 	for (Tile t : visibleTiles)
 	{
-		shader->setUniform("transform", calcTransform(t));
+		// Tiles stay in world space - the camera comes from the frame uniforms
+		commands->setUniform(offsetUniform, glm::vec2((float)(t.posX * TILE_SIZE), (float)(t.posY * TILE_SIZE)));
+
+		// The one path that picks the atlas frame on the CPU, so it resolves animations here rather than in the shader
+		commands->setUniform(frameUniform, tileFrameTransforms[tileAnimations->resolve(t.id % totalFrames, simulationTime)]);
 
-		shader->setUniform("frame", tileFrameTransforms[t.id % totalFrames]);
+		commands->drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		draws++;
 	}
 
-	glBindVertexArray(0);
+	return draws;
+}
+
+void queueSprites()
+{
+	spriteBatch->begin();
+
+	// Player - first frame of the sprite sheet, which is stored bottom-up
+	glm::vec4 frame(0.0f, 1.0f - (float)SPRITE_DIM / spriteHeight, (float)SPRITE_DIM / spriteWidth, 1.0f);
+
+	spriteBatch->draw(spriteTexture, location, glm::vec2(TILE_SIZE, TILE_SIZE), frame, { 1, 1, 1 }, 1);
+
+	if (spriteStress)
+	{
+		if (stressSprites.empty())
+		{
+			std::default_random_engine random(1337);
+			std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+
+			for (int i = 0; i < SPRITE_STRESS_COUNT; i++)
+			{
+				stressSprites.push_back(glm::vec2(offset(random) * WIDTH, offset(random) * HEIGHT));
+			}
+		}
+
+		float t = simulationTime;
+
+		for (int i = 0; i < SPRITE_STRESS_COUNT; i++)
+		{
+			glm::vec2 pos = stressSprites[i];
+
+			pos.x += std::sin(t + i) * 8.0f;
+			pos.y += std::cos(t + i) * 8.0f;
+
+			// Alternate between the sprite sheet and the tile atlas to exercise texture sorting
+			spriteBatch->draw((i & 1) ? spriteTexture : mapTexture, glm::vec2(camera.posx, camera.posy) + pos,
+				glm::vec2(16.0f, 16.0f), frame, { 1, 1, 1 }, 0, pos.y);
+		}
+	}
+}
+
+void renderSprites(RenderCommandList* commands)
+{
+	queueSprites();
+
+	drawCalls += spriteBatch->end(commands);
+}
+
+void updateLights()
+{
+	lights.clear();
+
+	if (lightCount <= 0)
+		return;
+
+	if ((int)lightAnchors.size() != lightCount)
+	{
+		std::default_random_engine random(4242);
+		std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+
+		lightAnchors.clear();
+
+		for (int i = 0; i < lightCount; i++)
+		{
+			lightAnchors.push_back(glm::vec2(offset(random) * WIDTH, offset(random) * HEIGHT));
+		}
+	}
+
+	// The player's torch
+	lights.push_back({ location, 192.0f, 1.2f, { 1.0f, 0.8f, 0.5f } });
+
+	// Torches and spells in a few hues, circling their spots on screen
+	const Colour palette[] = { { 1.0f, 0.6f, 0.3f }, { 0.3f, 0.6f, 1.0f }, { 0.6f, 1.0f, 0.4f }, { 1.0f, 0.3f, 0.8f } };
+
+	for (int i = 0; i < lightCount; i++)
+	{
+		float t = (simulationTime * 0.7f) + i;
+
+		glm::vec2 pos = glm::vec2(camera.posx, camera.posy) + lightAnchors[i] + (glm::vec2(std::sin(t), std::cos(t)) * 24.0f);
+
+		lights.push_back({ pos, 64.0f + ((i % 4) * 16.0f), 0.8f, palette[i % 4] });
+	}
+}
+
+// Records the frame - nothing reaches the GL until the render thread replays it
+void render(RenderCommandList* commands, int frameNumber, float delta)
+{
+	commands->beginFrame();
+
+	if (viewportChanged)
+	{
+		commands->viewport(0, 0, viewportWidth, viewportHeight);
+
+		viewportChanged = false;
+	}
+
+	commands->clear(GL_COLOR_BUFFER_BIT);
+
+	commands->blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Everything the programs share is uploaded once here, rather than set on each program per draw
+	FrameUniforms frame = {};
+
+	frame.viewProjection = calcView();
+	frame.camera = glm::vec2(camera.posx, camera.posy);
+	frame.viewport = glm::vec2((float)viewportWidth, (float)viewportHeight);
+	frame.time = simulationTime;
+	drawnTime = simulationTime;
+	frame.ambient = lightCount > 0 ? LIGHT_AMBIENT : 1.0f;
+	frame.zoom = zoom;
+
+	frameUniforms->update(commands, frame);
+
+	// Rebuilt every frame, since the lights are always moving when there are any
+	updateLights();
+
+	lightGrid->build(commands, lights, glm::vec2(camera.posx, camera.posy), zoom, viewportWidth, viewportHeight);
+	lightGrid->bind(commands);
 
-	shader->disable();
+	tileAnimations->bind(commands);
+
+	if (softwareRenderer != NULL)
+	{
+		// The sprites are queued as usual, but drawn from the batch by the software renderer
+		queueSprites();
+
+		softwareRenderer->render(dungeon, glm::vec2(camera.posx, camera.posy), simulationTime, spriteBatch);
+
+		// All the GPU does is show the frame
+		profiler->beginGpu(commands, frameNumber, GpuPass::MAP);
+		softwareRenderer->present(commands);
+		profiler->endGpu(commands, frameNumber, GpuPass::MAP);
+
+		drawCalls = 1;
+	}
+	else if (usesLod())
+	{
+		// Every layer is baked into the pyramid, so it's one pass with the sprites on top
+		profiler->beginGpu(commands, frameNumber, GpuPass::MAP);
+		drawCalls = lodRenderer->render(commands, visibleArea(), zoom);
+		profiler->endGpu(commands, frameNumber, GpuPass::MAP);
+
+		profiler->beginGpu(commands, frameNumber, GpuPass::SPRITES);
+		renderSprites(commands);
+		profiler->endGpu(commands, frameNumber, GpuPass::SPRITES);
+	}
+	else
+	{
+		// Layers go bottom to top, one batch each, with the sprites between the decals and the overhead layer
+		profiler->beginGpu(commands, frameNumber, GpuPass::MAP);
+		unsigned int features = shaderFeatures();
+
+		drawCalls = renderMap(commands, features);
+		drawCalls += layerRenderer->render(commands, TileLayer::WALLS, mapArrayTexture, features);
+		drawCalls += layerRenderer->render(commands, TileLayer::DECALS, mapArrayTexture, features);
+		profiler->endGpu(commands, frameNumber, GpuPass::MAP);
+
+		profiler->beginGpu(commands, frameNumber, GpuPass::SPRITES);
+		renderSprites(commands);
+		profiler->endGpu(commands, frameNumber, GpuPass::SPRITES);
+
+		profiler->beginGpu(commands, frameNumber, GpuPass::OVERHEAD);
+		drawCalls += layerRenderer->render(commands, TileLayer::OVERHEAD, mapArrayTexture, features);
+		profiler->endGpu(commands, frameNumber, GpuPass::OVERHEAD);
+	}
+
+	// Read back before the overlay, so the GL dump matches the software renderer's
+	if (captureFrame && softwareRenderer == NULL)
+		commands->readPixels(0, 0, WIDTH, HEIGHT, dumpPixels.data());
+
+	minimap->upload(commands);
+
+	if (showMinimap)
+		drawCalls += minimap->render(commands, location, viewportWidth, viewportHeight);
+
+	commands->endFrame();
 }
 
 void resetMovement()
@@ -402,6 +998,115 @@ void update(float delta)
 	}
 }
 
+// Anything moving on screen without input
+bool isAnimating()
+{
+	return spriteStress || lightCount > 0;
+}
+
+// First frames of the animations with a cell in view, in any layer - the pyramid is baked from still
+// frames, so nothing animates while it's drawn
+std::vector<unsigned int> visibleAnimations;
+
+void findVisibleAnimations()
+{
+	visibleAnimations.clear();
+
+	if (tileAnimations->getAnimationCount() == 0 || usesLod())
+		return;
+
+	TileRange range = dungeon->getVisibleRange(visibleArea());
+
+	if (range.empty())
+		return;
+
+	for (int y = range.firstY; y <= range.lastY; y++)
+	{
+		for (int x = range.firstX; x <= range.lastX; x++)
+		{
+			for (int layer = (int)TileLayer::FLOOR; layer < (int)TileLayer::COUNT; layer++)
+			{
+				unsigned int id = dungeon->getLayerTile((TileLayer)layer, x, y);
+
+				if (id == LAYER_EMPTY)
+					continue;
+
+				unsigned int frame = id % totalFrames;
+
+				if (tileAnimations->isAnimated(frame) && std::find(visibleAnimations.begin(), visibleAnimations.end(), frame) == visibleAnimations.end())
+					visibleAnimations.push_back(frame);
+			}
+		}
+	}
+}
+
+// Whether a visible animation shows a different frame now than in the last frame drawn
+bool animationFrameChanged()
+{
+	for (unsigned int frame : visibleAnimations)
+	{
+		if (tileAnimations->resolve(frame, simulationTime) != tileAnimations->resolve(frame, drawnTime))
+			return true;
+	}
+
+	return false;
+}
+
+// How long the idle loop can sleep before a visible animation needs its next frame drawn
+double idleTimeout()
+{
+	double timeout = IDLE_WAIT_TIMEOUT;
+
+	for (unsigned int frame : visibleAnimations)
+		timeout = std::min(timeout, (double)tileAnimations->timeToNextFrame(frame, simulationTime));
+
+	return timeout;
+}
+
+bool needsRedraw()
+{
+	return moving || updatedCameraMovement || viewportChanged || redrawRequested || isAnimating() || animationFrameChanged() || dungeon->hasChangedTiles();
+}
+
+// Blocks until there's something new to draw. Timed runs and headless runs always draw.
+void waitWhileIdle()
+{
+	if (!idleRedraw || window == NULL || benchmarkFrames > 0)
+		return;
+
+	bool waited = false;
+
+	while (!glfwWindowShouldClose(window))
+	{
+		processInput(window);
+
+		if (needsRedraw())
+			break;
+
+		double sleepStart = glfwGetTime();
+
+		glfwWaitEventsTimeout(idleTimeout());
+
+		// The animation clock keeps running while asleep, so the next animation frame comes due on time. The
+		// simulation step doesn't - see below.
+		simulationTime += (float)(glfwGetTime() - sleepStart);
+
+		waited = true;
+	}
+
+	// Carry on as if the last frame had just been drawn, rather than catching up on the time spent asleep
+	if (waited)
+		lastFrame = (float)glfwGetTime() - FIXED_TIME_STEP;
+}
+
+bool shouldQuit(int frame)
+{
+	if (benchmarkFrames > 0 && frame >= benchmarkFrames)
+		return true;
+
+	return window != NULL && glfwWindowShouldClose(window);
+}
+
 void gameLoop()
 {
 #ifdef DEBUG_ON	
@@ -413,10 +1118,31 @@ void gameLoop()
 #ifdef DEBUG_ON	
 	double time = 0.0;
 	int frames = 0;
+
+	// Time spent recording in render(), replaying on the render thread, and total draw calls over the current second
+	double renderTime = 0.0;
+	double replayTime = 0.0;
+	long long totalDrawCalls = 0;
+
+	// Stream buffer upload volume and GPU waits over the current second
+	long long streamBytes = 0;
+	int streamStalls = 0;
+
+	// GL state calls issued and dropped as redundant over the current second
+	long long stateIssued = 0;
+	long long stateSkipped = 0;
+
+	// Minimap texels re-uploaded over the current second
+	long long minimapTexels = 0;
 #endif
 	
-	while (!glfwWindowShouldClose(window))
+	for (int frame = 0; !shouldQuit(frame); frame++)
 	{
+		waitWhileIdle();
+
+		if (shouldQuit(frame))
+			break;
+
 		currentFrame = glfwGetTime();
 
 		deltaTime = currentFrame - lastFrame;
@@ -428,30 +1154,150 @@ void gameLoop()
 
 		if (time >= 1.0)
 		{
-			glfwSetWindowTitle(window, std::to_string(frames).c_str());
+			char backend[64];
+
+			if (softwareRenderer != NULL)
+				sprintf_s(backend, "software %d threads, %s", softwareRenderer->getThreadCount(), softwareRenderer->usesAvx2() ? "avx2" : "sse2");
+			else if (usesLod())
+				sprintf_s(backend, "lod level %d of %d, zoom %.3f", lodRenderer->getLevel(zoom), lodRenderer->getLevelCount(), zoom);
+			else
+				sprintf_s(backend, "%s, zoom %.3f", renderModeName(renderMode), zoom);
+
+			// Per-stage means over the frames timed this second, GPU times lagging a frame or two behind
+			ProfiledFrame profile = profiler->getAverage(frames);
+
+			LightGridStats lighting = lightGrid->getStats();
+
+			char title[512];
+			sprintf_s(title, "%d fps | %.3f ms/frame | record %.3f ms | replay %.3f ms (%s) | swap %.3f ms | gpu map %.3f ms, sprites %.3f ms | %lld draws | %s | %zu sprites | %d lights, %d max/tile | minimap %lld texels/frame | stream %lld KB/frame, %d stalls | state %lld set, %lld skipped",
+				frames, 1000.0 * time / frames, 1000.0 * renderTime / frames, 1000.0 * replayTime / frames,
+				renderThread->isThreaded() ? "threaded" : "inline", 1000.0 * profile.cpu[(int)ProfileStage::SWAP],
+				1000.0 * std::max(profile.gpu[(int)GpuPass::MAP], 0.0), 1000.0 * std::max(profile.gpu[(int)GpuPass::SPRITES], 0.0), totalDrawCalls / frames, backend,
+				spriteBatch->getSpriteCount(), lighting.visible, lighting.maxPerTile, minimapTexels / frames, streamBytes / frames / 1024, streamStalls, stateIssued / frames, stateSkipped / frames);
+
+			if (window != NULL)
+				glfwSetWindowTitle(window, title);
+			else
+				printf("%s\n", title);
 
 			frames = 0;
 			time = 0;
+			renderTime = 0;
+			replayTime = 0;
+			totalDrawCalls = 0;
+			streamBytes = 0;
+			streamStalls = 0;
+			stateIssued = 0;
+			stateSkipped = 0;
+			minimapTexels = 0;
 		}
 #endif
 
-		processInput(window);		
-		
-		update(deltaTime / TARGET_UPDATE_TIME);
-				
-		updateCamera(deltaTime / TARGET_UPDATE_TIME);
+		if (benchmarkFrames > 0)
+			deltaTime = FIXED_TIME_STEP;
+
+		simulationTime += deltaTime;
+
+		captureFrame = dumpFile != NULL && frame == benchmarkFrames - 1;
+
+		profiler->beginFrame(frame);
+
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::INPUT);
+
+			processInput(window);
+		}
+
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::UPDATE);
+
+			update(deltaTime / TARGET_UPDATE_TIME);
+		}
 
-		if (updatedCameraMovement) {
-			visibleTiles = dungeon->getVisibleTiles(camera.posx, camera.posy);
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::CAMERA);
+
+			updateCamera(deltaTime / TARGET_UPDATE_TIME);
+		}
+
+		RenderCommandList* commands = renderThread->getCommands();
+
+		std::vector<glm::ivec2> changedTiles = dungeon->takeChangedTiles();
+
+		if (!changedTiles.empty())
+		{
+			chunkRenderer->update(commands, changedTiles);
+			tileMapRenderer->update(commands, changedTiles);
+			minimap->update(changedTiles);
+			lodRenderer->update(commands, changedTiles);
+
+			updatedCameraMovement = true;
+		}
+
+		minimap->reveal(location, MINIMAP_REVEAL_RADIUS);
+
+		// Chunks and the tile map are static on the GPU, so only the other paths need the visible set rebuilt
+		if (updatedCameraMovement && (renderMode == RenderMode::PER_TILE || renderMode == RenderMode::INSTANCED) && !usesLod()) {
+			ProfileScope scope(profiler, frame, ProfileStage::VISIBLE_TILES);
+
+			// Refills the same vector, so its storage is reused from frame to frame
+			dungeon->getVisibleTiles(visibleArea(), visibleTiles);
+
+			tileRenderer->setTiles(commands, visibleTiles, totalFrames);
+		}
+
+		// The sparse layers are culled in every mode, but that only visits the chunks in view. The pyramid has them baked in.
+		bool changedLayers = dungeon->takeChangedLayers() != 0;
 
-			updatedCameraMovement = false;
+		if ((changedLayers || updatedCameraMovement) && !usesLod())
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::VISIBLE_TILES);
+
+			layerRenderer->setVisible(commands, dungeon, visibleArea(), totalFrames);
 		}
 
-		render(deltaTime / TARGET_UPDATE_TIME);
+		if (changedLayers || updatedCameraMovement)
+			findVisibleAnimations();
+
+		updatedCameraMovement = false;
+
+#ifdef DEBUG_ON
+		double renderStart = glfwGetTime();
+#endif
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::RECORD);
+
+			render(commands, frame, deltaTime / TARGET_UPDATE_TIME);
+		}
+
+		redrawRequested = false;
+
+#ifdef DEBUG_ON
+		renderTime += glfwGetTime() - renderStart;
+		minimapTexels += minimap->getUploadedTexels();
+#endif
 
 		resetMovement();
 
-		glfwSwapBuffers(window);
+		// Replaces glfwSwapBuffers() - the swap happens after the list has been replayed. Threaded this is the
+		// wait for the previous frame, inline it includes replaying this one.
+		{
+			ProfileScope scope(profiler, frame, ProfileStage::SUBMIT);
+
+			renderThread->submit();
+		}
+
+#ifdef DEBUG_ON
+		// Stats lag a frame behind when threaded, since they come from the last replayed list
+		RenderFrameStats frameStats = renderThread->getStats();
+
+		replayTime += renderThread->getReplayTime();
+		totalDrawCalls += frameStats.drawCalls;
+		streamBytes += frameStats.stream.bytesUploaded;
+		streamStalls += frameStats.stream.stalls;
+		stateIssued += frameStats.state.issued;
+		stateSkipped += frameStats.state.skipped;
+#endif
 
 		glfwPollEvents();
 
@@ -459,26 +1305,332 @@ void gameLoop()
 }
 
 
-int main()
+void reportHeadlessRun()
 {
+	int frames = std::max(renderThread->getFramesReplayed(), 1);
+
+	RenderFrameStats totals = renderThread->getTotals();
+
+	printf("Headless run: %d frames, %s, zoom %.3f, %s%s\n", renderThread->getFramesReplayed(),
+		softwareRenderer != NULL ? "software" : usesLod() ? "lod" : renderModeName(renderMode), zoom,
+		renderThread->isThreaded() ? "threaded" : "inline", spriteStress ? ", sprite stress" : "");
+
+	printf("Per frame: %.1f draws | %.1f GL calls | %.1f state changes (%.1f dropped as redundant) | %.1f uniform sets | %.1f KB uploaded\n",
+		(double)totals.nullGL.drawCalls / frames, (double)totals.nullGL.calls / frames, (double)totals.nullGL.stateChanges / frames,
+		(double)totals.state.skipped / frames, (double)totals.nullGL.uniformSets / frames, totals.nullGL.bytesUploaded / 1024.0 / frames);
+
+	ProfiledFrame profile = profiler->getAverage(PROFILER_HISTORY);
+
+	printf("Per frame (ms, last %d frames):", std::min(frames, PROFILER_HISTORY / 2));
+
+	for (int i = 0; i < (int)ProfileStage::COUNT; i++)
+		printf(" %s %.3f |", profileStageName((ProfileStage)i), 1000.0 * profile.cpu[i]);
+
+	// Passes that never ran have no result
+	for (int i = 0; i < (int)GpuPass::COUNT; i++)
+		printf(" gpu %s %.3f%s", gpuPassName((GpuPass)i), 1000.0 * std::max(profile.gpu[i], 0.0), i + 1 < (int)GpuPass::COUNT ? " |" : "\n");
+
+	if (traceFile != NULL)
+	{
+		FILE* file;
+
+		if (fopen_s(&file, traceFile, "w") == 0)
+		{
+			nullGLWriteTrace(file);
+			fclose(file);
+
+			printf("Wrote the last frame's GL calls to %s\n", traceFile);
+		}
+	}
+}
+
+// Both ways pay the null backend's recording, so what differs is the lookup
+void runUniformBench()
+{
+	ShaderProgram* program = tileShaders->get(shaderFeatures());
+
+	Uniform<glm::vec2> offset = program->addUniform<glm::vec2>("offset");
+	Uniform<glm::mat4> frameTransform = program->addUniform<glm::mat4>("frame");
+
+	// How setUniform() looked names up before the handles - a std::map searched twice per set
+	std::map<std::string, int> uniformMap;
+
+	uniformMap["offset"] = program->uniform("offset");
+	uniformMap["frame"] = program->uniform("frame");
+
+	auto oldUniform = [&uniformMap](const std::string& uniformName)
+	{
+		if (uniformMap.find(uniformName) == uniformMap.end())
+			throw std::runtime_error("Could not find uniform in shader program: " + uniformName);
+
+		return uniformMap[uniformName];
+	};
+
+	const std::vector<Tile>& tiles = dungeon->getTiles();
+
+	glUseProgram(program->getId());
+
+	const char* names[] = { "string + map lookup (old setUniform)", "by name (setUniform with a string)", "typed handle" };
+	double seconds[3] = {};
+
+	for (int path = 0; path < 3; path++)
+	{
+		for (int frame = 0; frame < UNIFORM_BENCH_FRAMES; frame++)
+		{
+			double start = glfwGetTime();
+
+			for (const Tile& t : tiles)
+			{
+				glm::vec2 position((float)(t.posX * TILE_SIZE), (float)(t.posY * TILE_SIZE));
+				const glm::mat4& transform = tileFrameTransforms[t.id % totalFrames];
+
+				if (path == 0)
+				{
+					glUniform2fv(oldUniform("offset"), 1, &position[0]);
+					glUniformMatrix4fv(oldUniform("frame"), 1, GL_FALSE, &transform[0][0]);
+				}
+				else if (path == 1)
+				{
+					program->setUniform("offset", position);
+					program->setUniform("frame", transform);
+				}
+				else
+				{
+					program->setUniform(offset, position);
+					program->setUniform(frameTransform, transform);
+				}
+			}
+
+			seconds[path] += glfwGetTime() - start;
+
+			// Keeps the recorded calls to one frame's worth
+			nullGLEndFrame();
+		}
+	}
+
+	int sets = (int)tiles.size() * 2;
+
+	printf("Uniform bench: %d sets per frame (%d tiles), %d frames\n", sets, (int)tiles.size(), UNIFORM_BENCH_FRAMES);
+
+	for (int path = 0; path < 3; path++)
+		printf("  %-40s %.3f ms/frame, %.1f ns/set\n", names[path], 1000.0 * seconds[path] / UNIFORM_BENCH_FRAMES,
+			1.0e9 * seconds[path] / ((double)UNIFORM_BENCH_FRAMES * sets));
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--single-threaded") == 0)
+			singleThreaded = true;
+
+		if (strcmp(argv[i], "--null-gl") == 0)
+			nullBackend = true;
+
+		if (strcmp(argv[i], "--uniform-bench") == 0)
+		{
+			uniformBench = true;
+			nullBackend = true;
+		}
+
+		if (strcmp(argv[i], "--sprite-stress") == 0)
+			spriteStress = true;
+
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			benchmarkFrames = atoi(argv[++i]);
+
+		if (strcmp(argv[i], "--gl-trace") == 0 && i + 1 < argc)
+			traceFile = argv[++i];
+
+		if (strcmp(argv[i], "--software") == 0)
+			softwareBackend = true;
+
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			softwareThreads = atoi(argv[++i]);
+
+		if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+			dumpFile = argv[++i];
+
+		if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+			lightCount = std::max(atoi(argv[++i]), 0);
+
+		if (strcmp(argv[i], "--always-redraw") == 0)
+			idleRedraw = false;
+
+		if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc)
+			zoom = glm::clamp((float)atof(argv[++i]), ZOOM_MIN, ZOOM_MAX);
+
+		if (strcmp(argv[i], "--no-texture-cache") == 0)
+			useTextureCache = false;
+
+		if (strcmp(argv[i], "--no-shader-cache") == 0)
+			useShaderCache = false;
+
+		if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			profileFile = argv[++i];
+
+		// Same order as F1-F4
+		if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+			renderMode = (RenderMode)glm::clamp(atoi(argv[++i]) - 1, 0, (int)RenderMode::TILE_MAP);
+	}
+
+	if (nullBackend && benchmarkFrames <= 0)
+		benchmarkFrames = HEADLESS_FRAMES;
+
+	if (softwareBackend && zoom != 1.0f)
+	{
+		printf("The software renderer only draws at a zoom of 1 - ignoring --zoom\n");
+		zoom = 1.0f;
+	}
+
+	if (dumpFile != NULL)
+	{
+		if (benchmarkFrames <= 0)
+		{
+			printf("--dump needs --frames, so it knows which frame to save\n");
+			dumpFile = NULL;
+		}
+		else
+		{
+			dumpPixels.resize(WIDTH * HEIGHT * 4);
+
+			if (nullBackend && !softwareBackend)
+				printf("The null GL backend has no framebuffer - %s will be blank\n", dumpFile);
+		}
+	}
+
 	if (initialise() != INITIALISE_SUCCESS)
 	{
 		return -1;
 	}
 
-	initShaders();
+	textureCache = useTextureCache ? new TextureCache(TEXTURE_CACHE_DIR) : NULL;
+	textureUploader = new TextureUploader(textureCache);
 
+	// Decoding runs alongside compiling the shaders and generating the dungeon
 	initTextures("./res/textures/");
 
+	programCache = useShaderCache ? new ProgramBinaryCache(SHADER_CACHE_DIR) : NULL;
+	ShaderProgram::setBinaryCache(programCache);
+
+	initShaders();
+
 	generateDungeon();
+
+	finishTextures();
+
+	// Start frame, frame count and seconds per frame of each animated tile
+	tileAnimations->loadFromFile("./res/animations.txt", totalFrames);
+
+	if (softwareRenderer != NULL)
+		softwareRenderer->setAnimations(tileAnimations);
+
+	chunkRenderer->build(dungeon, totalFrames);
+	tileMapRenderer->build(dungeon, totalFrames);
+	minimap->build(dungeon);
+	lodRenderer->build(dungeon);
+
+	for (const Tile& t : dungeon->getTiles())
+	{
+		if (t.colour.r != 1.0f || t.colour.g != 1.0f || t.colour.b != 1.0f || t.colour.w != 1.0f)
+			tintedTiles = true;
+	}
+
+	ShaderBuildStats shaderStats = ShaderProgram::getBuildStats();
+
+	printf("Built %d shader programs (%d + %d variants) in %.2f ms, %d from the binary cache\n", shaderStats.programs,
+		tileShaders->getVariantCount(), instancedShaders->getVariantCount(), 1000.0 * shaderStats.seconds, shaderStats.fromBinary);
+
+	if (uniformBench)
+	{
+		runUniformBench();
+
+		delete textureUploader;
+		glfwTerminate();
+
+		return 0;
+	}
 	
 	location = glm::vec2((float)WIDTH / 2.0f, (float)HEIGHT / 2.0f);
 	camera = { (float)WIDTH / 2.0f, (float)HEIGHT / 2.0f };
 
+	profiler = new FrameProfiler();
+
+	renderThread = new RenderThread(window, streamBuffer, profiler, !singleThreaded);
+
+	// Textures loaded from here on are moved along between frames by whichever thread has the context
+	renderThread->setTextureUploader(textureUploader);
+	renderThread->addShaderVariants(tileShaders);
+	renderThread->addShaderVariants(instancedShaders);
+
+	if (nullBackend)
+	{
+		// Everything up to here was loading, keep it out of the per-frame numbers
+		NullGLStats startup = nullGLEndFrame();
+
+		printf("Null GL startup: %d calls, %.1f KB uploaded\n", startup.calls, startup.bytesUploaded / 1024.0);
+	}
+
+	renderThread->start();
+
 	gameLoop();
 
+	// Takes the context back for the cleanup below
+	renderThread->stop();
+
+	if (nullBackend)
+		reportHeadlessRun();
+
+	// The last replay has finished, so a GL read back has landed too
+	if (dumpFile != NULL)
+	{
+		const unsigned char* pixels = softwareRenderer != NULL ? softwareRenderer->getPixels() : dumpPixels.data();
+
+		if (writePng(dumpFile, WIDTH, HEIGHT, pixels))
+			printf("Wrote the last frame to %s\n", dumpFile);
+		else
+			printf("Failed to write %s\n", dumpFile);
+	}
+
+	if (profileFile != NULL)
+	{
+		FILE* file;
+
+		if (fopen_s(&file, profileFile, "w") == 0)
+		{
+			profiler->writeCsv(file);
+			fclose(file);
+
+			printf("Wrote per-frame stage times to %s\n", profileFile);
+		}
+	}
+
+	delete renderThread;
+	delete textureUploader;
+	delete textureCache;
+
+	ShaderProgram::setBinaryCache(NULL);
+	delete programCache;
+
+	delete softwareRenderer;
+	delete profiler;
+
 	delete dungeon;
-	delete shader;
+	delete tileRenderer;
+	delete chunkRenderer;
+	delete tileMapRenderer;
+	delete layerRenderer;
+	delete spriteBatch;
+	delete streamBuffer;
+	delete frameUniforms;
+	delete lightGrid;
+	delete minimap;
+	delete lodRenderer;
+	delete tileAnimations;
+	delete tileShaders;
+	delete instancedShaders;
+
+	glDeleteTextures(1, &mapArrayTexture);
 
 	glfwTerminate();
 
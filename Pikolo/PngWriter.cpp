@@ -0,0 +1,137 @@
+#include "stdafx.h"
+
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+
+static std::uint32_t crcTable[256];
+
+static void buildCrcTable()
+{
+	for (std::uint32_t n = 0; n < 256; n++)
+	{
+		std::uint32_t c = n;
+
+		for (int k = 0; k < 8; k++)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+		crcTable[n] = c;
+	}
+}
+
+static std::uint32_t crc(std::uint32_t c, const unsigned char* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		c = crcTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+
+	return c;
+}
+
+static void putBigEndian(std::vector<unsigned char>& out, std::uint32_t value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void writeChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> header;
+	putBigEndian(header, (std::uint32_t)data.size());
+
+	fwrite(header.data(), 1, 4, file);
+
+	std::uint32_t c = crc(0xFFFFFFFFu, (const unsigned char*)type, 4);
+	c = crc(c, data.data(), data.size());
+
+	fwrite(type, 1, 4, file);
+	fwrite(data.data(), 1, data.size(), file);
+
+	std::vector<unsigned char> footer;
+	putBigEndian(footer, c ^ 0xFFFFFFFFu);
+
+	fwrite(footer.data(), 1, 4, file);
+}
+
+bool writePng(const char* path, int width, int height, const unsigned char* rgba)
+{
+	FILE* file;
+
+	if (fopen_s(&file, path, "wb") != 0)
+		return false;
+
+	if (crcTable[1] == 0)
+		buildCrcTable();
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, 8, file);
+
+	std::vector<unsigned char> ihdr;
+	putBigEndian(ihdr, width);
+	putBigEndian(ihdr, height);
+	ihdr.push_back(8);	// bit depth
+	ihdr.push_back(6);	// colour type RGBA
+	ihdr.push_back(0);	// deflate
+	ihdr.push_back(0);	// adaptive filtering
+	ihdr.push_back(0);	// no interlace
+
+	writeChunk(file, "IHDR", ihdr);
+
+	// Scanlines top-down, each prefixed with filter type 0 (none)
+	const size_t rowBytes = (size_t)width * 4;
+
+	std::vector<unsigned char> raw;
+	raw.reserve((rowBytes + 1) * height);
+
+	for (int y = height - 1; y >= 0; y--)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + (y * rowBytes), rgba + ((y + 1) * rowBytes));
+	}
+
+	// zlib stream of stored deflate blocks, at most 65535 bytes each
+	std::vector<unsigned char> idat;
+	idat.reserve(raw.size() + (raw.size() / 65535 + 1) * 5 + 6);
+
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+
+	size_t offset = 0;
+
+	do
+	{
+		size_t size = std::min(raw.size() - offset, (size_t)65535);
+		bool last = offset + size == raw.size();
+
+		idat.push_back(last ? 1 : 0);
+		idat.push_back((unsigned char)size);
+		idat.push_back((unsigned char)(size >> 8));
+		idat.push_back((unsigned char)~size);
+		idat.push_back((unsigned char)(~size >> 8));
+
+		idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+		offset += size;
+	} while (offset < raw.size());
+
+	std::uint32_t a = 1, b = 0;
+
+	for (unsigned char byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	putBigEndian(idat, (b << 16) | a);
+
+	writeChunk(file, "IDAT", idat);
+	writeChunk(file, "IEND", std::vector<unsigned char>());
+
+	bool ok = ferror(file) == 0;
+
+	fclose(file);
+
+	return ok;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Writes 8-bit RGBA pixels as a PNG. Rows are given bottom-up, the way GL and the software renderer store
+// them. The image data is stored uncompressed inside the zlib stream - files are large but exact, and need
+// no compression library.
+bool writePng(const char* path, int width, int height, const unsigned char* rgba);
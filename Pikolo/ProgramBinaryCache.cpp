@@ -0,0 +1,166 @@
+#include "stdafx.h"
+
+#include "ProgramBinaryCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace fs = std::experimental::filesystem;
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory)
+{
+	this->directory = directory;
+
+	getProgramBinary = NULL;
+	programBinary = NULL;
+	programParameteri = NULL;
+
+	if (glfwExtensionSupported("GL_ARB_get_program_binary"))
+	{
+		getProgramBinary = (PFNGLGETPROGRAMBINARYPROC_ARB)glfwGetProcAddress("glGetProgramBinary");
+		programBinary = (PFNGLPROGRAMBINARYPROC_ARB)glfwGetProcAddress("glProgramBinary");
+		programParameteri = (PFNGLPROGRAMPARAMETERIPROC_ARB)glfwGetProcAddress("glProgramParameteri");
+	}
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	supported = getProgramBinary != NULL && programBinary != NULL && programParameteri != NULL && formats > 0;
+
+	const char* strings[] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+
+	for (const char* s : strings)
+	{
+		driver += s != NULL ? s : "";
+		driver += '\n';
+	}
+
+#ifdef DEBUG_ON
+	printf("Program binary cache %s, %d binary formats\n", supported ? "enabled" : "unavailable", formats);
+#endif
+}
+
+bool ProgramBinaryCache::isSupported()
+{
+	return supported;
+}
+
+std::string ProgramBinaryCache::entryPath(std::uint64_t key)
+{
+	char name[32];
+	sprintf_s(name, "%016llx.bin", (unsigned long long)key);
+
+	return (fs::path(directory) / name).string();
+}
+
+std::uint64_t ProgramBinaryCache::key(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	std::uint64_t h = FNV_OFFSET_BASIS;
+
+	const std::string* parts[] = { &driver, &vertexSource, &fragmentSource };
+
+	// The terminators keep "ab" + "c" and "a" + "bc" apart
+	const unsigned char terminator = 0xff;
+
+	for (const std::string* part : parts)
+	{
+		h = fnv1a(part->data(), part->size(), h);
+		h = fnv1a(&terminator, 1, h);
+	}
+
+	return h;
+}
+
+void ProgramBinaryCache::prepare(GLuint program)
+{
+	if (supported)
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramBinaryCache::load(std::uint64_t key, GLuint program)
+{
+	if (!supported)
+		return false;
+
+	std::string path = entryPath(key);
+
+	FILE* file;
+
+	if (fopen_s(&file, path.c_str(), "rb") != 0)
+		return false;
+
+	ProgramCacheHeader header;
+	std::vector<unsigned char> binary;
+
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "PKSB", 4) == 0 &&
+		header.version == PROGRAM_CACHE_VERSION && header.key == key && header.length > 0;
+
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+
+	fclose(file);
+
+	if (valid)
+	{
+		programBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+		valid = linked == GL_TRUE;
+	}
+
+	// Refused or damaged - it'll be replaced once the program has been built from source
+	if (!valid)
+	{
+		std::error_code error;
+		fs::remove(path, error);
+
+#ifdef DEBUG_ON
+		printf("Dropped program binary %s\n", path.c_str());
+#endif
+	}
+
+	return valid;
+}
+
+bool ProgramBinaryCache::store(std::uint64_t key, GLuint program)
+{
+	if (!supported)
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return false;
+
+	std::vector<unsigned char> binary(length);
+
+	GLenum format = 0;
+	getProgramBinary(program, length, &length, &format, binary.data());
+
+	ProgramCacheHeader header = {};
+
+	memcpy(header.magic, "PKSB", 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (std::uint32_t)length;
+
+	std::error_code error;
+
+	fs::create_directories(directory, error);
+
+	return writeFileAtomically(entryPath(key), &header, sizeof(header), binary.data(), (size_t)length);
+}
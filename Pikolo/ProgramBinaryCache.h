@@ -0,0 +1,71 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CacheFile.h"
+
+#include <cstdint>
+#include <string>
+
+// Bumped whenever the layout of a cache entry changes, so stale entries are rebuilt
+#define PROGRAM_CACHE_VERSION 1
+
+// Start of every cache entry, followed by the driver's binary
+struct ProgramCacheHeader {
+
+	char magic[4];
+	std::uint32_t version;
+
+	// What the entry was built from - see ProgramBinaryCache::key()
+	std::uint64_t key;
+
+	// The driver's own format enum and the binary's size in bytes
+	std::uint32_t format;
+	std::uint32_t length;
+};
+
+// GL_ARB_get_program_binary isn't part of our 3.3 core loader either
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC_ARB)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC_ARB)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC_ARB)(GLuint program, GLenum pname, GLint value);
+
+// Linked programs saved with glGetProgramBinary, so later runs skip compiling and linking. A binary is
+// only good for the driver that made it, and a driver may still refuse one (e.g. after an update that
+// kept the version string) - a load that fails just means building from source again.
+class ProgramBinaryCache
+{
+private:
+
+	std::string directory;
+
+	// Vendor, renderer and version, hashed into every key
+	std::string driver;
+
+	// Without the extension, or with no binary formats (e.g. the null backend), nothing is cached
+	bool supported;
+
+	PFNGLGETPROGRAMBINARYPROC_ARB getProgramBinary;
+	PFNGLPROGRAMBINARYPROC_ARB programBinary;
+	PFNGLPROGRAMPARAMETERIPROC_ARB programParameteri;
+
+	// Entries are named after their key, e.g. 0123456789abcdef.bin
+	std::string entryPath(std::uint64_t key);
+
+public:
+	// Needs a current context, to ask about the driver
+	ProgramBinaryCache(const std::string& directory);
+
+	bool isSupported();
+
+	// FNV-1a of the driver and the sources exactly as they're compiled, so anything injected into them counts too
+	std::uint64_t key(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// Asks the driver to keep the program's binary around - call before linking
+	void prepare(GLuint program);
+
+	// Links the program from its entry - false if there isn't one or the driver refused it
+	bool load(std::uint64_t key, GLuint program);
+
+	// Saves a linked program's binary
+	bool store(std::uint64_t key, GLuint program);
+};
@@ -0,0 +1,428 @@
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+RenderCommandList::RenderCommandList()
+{
+	// Enough for a typical frame, so the first few frames don't grow the arenas one step at a time
+	commands.reserve(64 * 1024);
+	payload.reserve(1024 * 1024);
+
+#ifdef _DEBUG
+	program = 0;
+#endif
+}
+
+void RenderCommandList::reset()
+{
+	commands.clear();
+	payload.clear();
+
+#ifdef _DEBUG
+	program = 0;
+#endif
+}
+
+bool RenderCommandList::isEmpty()
+{
+	return commands.empty();
+}
+
+template<typename T>
+T* RenderCommandList::push(RenderCommandType type)
+{
+	// Keep every command 8 byte aligned
+	const size_t size = (sizeof(RenderCommandHeader) + sizeof(T) + 7) & ~(size_t)7;
+
+	size_t at = commands.size();
+	commands.resize(at + size);
+
+	RenderCommandHeader* header = (RenderCommandHeader*)&commands[at];
+	header->type = type;
+	header->size = (unsigned int)size;
+
+	return (T*)&commands[at + sizeof(RenderCommandHeader)];
+}
+
+size_t RenderCommandList::pushPayload(const void* data, size_t size)
+{
+	size_t at = (payload.size() + 15) & ~(size_t)15;
+
+	payload.resize(at + size);
+
+	if (data != NULL)
+		memcpy(&payload[at], data, size);
+
+	return at;
+}
+
+void RenderCommandList::beginFrame()
+{
+	push<EmptyCommand>(RenderCommandType::BEGIN_FRAME);
+}
+
+void RenderCommandList::endFrame()
+{
+	push<EmptyCommand>(RenderCommandType::END_FRAME);
+}
+
+void RenderCommandList::clear(GLbitfield mask)
+{
+	push<ClearCommand>(RenderCommandType::CLEAR)->mask = mask;
+}
+
+void RenderCommandList::viewport(int x, int y, int width, int height)
+{
+	*push<ViewportCommand>(RenderCommandType::VIEWPORT) = { x, y, width, height };
+}
+
+void RenderCommandList::blend(bool enabled, GLenum src, GLenum dst)
+{
+	*push<BlendCommand>(RenderCommandType::BLEND) = { enabled, src, dst };
+}
+
+void RenderCommandList::useProgram(unsigned int program)
+{
+	push<UseProgramCommand>(RenderCommandType::USE_PROGRAM)->program = program;
+
+#ifdef _DEBUG
+	this->program = program;
+#endif
+}
+
+#ifdef _DEBUG
+// Checked as it's recorded, while the caller is still on the stack - the handle has to belong to the program
+// in use, and its location and type have to match that program's reflected table
+template<typename T>
+void RenderCommandList::validate(Uniform<T> uniform)
+{
+	if (uniform.program != program)
+		throw std::runtime_error("Uniform at location " + std::to_string(uniform.location) + " of program " + std::to_string(uniform.program) +
+			" recorded while program " + std::to_string(program) + " is in use.");
+
+	ShaderProgram::validateRecorded(uniform);
+}
+#endif
+
+void RenderCommandList::setUniform(Uniform<int> uniform, int value)
+{
+#ifdef _DEBUG
+	validate(uniform);
+#endif
+	*push<UniformIntCommand>(RenderCommandType::UNIFORM_INT) = { uniform.location, value };
+}
+
+void RenderCommandList::setUniform(Uniform<glm::vec2> uniform, const glm::vec2& value)
+{
+#ifdef _DEBUG
+	validate(uniform);
+#endif
+	*push<UniformVec2Command>(RenderCommandType::UNIFORM_VEC2) = { uniform.location, value };
+}
+
+void RenderCommandList::setUniform(Uniform<glm::mat4> uniform, const glm::mat4& value)
+{
+#ifdef _DEBUG
+	validate(uniform);
+#endif
+	*push<UniformMat4Command>(RenderCommandType::UNIFORM_MAT4) = { uniform.location, value };
+}
+
+void RenderCommandList::bindVertexArray(unsigned int vao)
+{
+	push<BindVertexArrayCommand>(RenderCommandType::BIND_VERTEX_ARRAY)->vao = vao;
+}
+
+void RenderCommandList::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	*push<BindTextureCommand>(RenderCommandType::BIND_TEXTURE) = { unit, target, texture };
+}
+
+void RenderCommandList::bufferData(GLenum target, unsigned int buffer, size_t size, const void* data, GLenum usage)
+{
+	size_t at = data != NULL ? pushPayload(data, size) : 0;
+
+	*push<BufferDataCommand>(RenderCommandType::BUFFER_DATA) = { target, buffer, usage, size, at, data != NULL };
+}
+
+void RenderCommandList::bufferSubData(GLenum target, unsigned int buffer, size_t offset, size_t size, const void* data)
+{
+	size_t at = pushPayload(data, size);
+
+	*push<BufferSubDataCommand>(RenderCommandType::BUFFER_SUB_DATA) = { target, buffer, offset, size, at };
+}
+
+void RenderCommandList::texSubImage2D(GLenum target, unsigned int texture, int x, int y, int width, int height,
+	GLenum format, GLenum type, int texelSize, int rowLength, const void* data)
+{
+	// Pack just the rectangle, tightly, so the replay doesn't need the source image
+	size_t rowBytes = width * texelSize;
+	size_t at = pushPayload(NULL, rowBytes * height);
+
+	for (int row = 0; row < height; row++)
+	{
+		memcpy(&payload[at + (row * rowBytes)], (const unsigned char*)data + ((size_t)row * rowLength * texelSize), rowBytes);
+	}
+
+	*push<TexSubImage2DCommand>(RenderCommandType::TEX_SUB_IMAGE_2D) = { target, texture, x, y, width, height, format, type, at };
+}
+
+void* RenderCommandList::streamVertices(size_t size, size_t stride)
+{
+	size_t at = pushPayload(NULL, size);
+
+	*push<StreamVerticesCommand>(RenderCommandType::STREAM_VERTICES) = { size, stride, at };
+
+	return &payload[at];
+}
+
+void RenderCommandList::drawArrays(GLenum mode, int first, int count)
+{
+	*push<DrawArraysCommand>(RenderCommandType::DRAW_ARRAYS) = { mode, first, count };
+}
+
+void RenderCommandList::drawElements(GLenum mode, int count, GLenum type, size_t offset)
+{
+	*push<DrawElementsCommand>(RenderCommandType::DRAW_ELEMENTS) = { mode, count, type, offset, 0, false };
+}
+
+void RenderCommandList::drawStreamedElements(GLenum mode, int count, GLenum type, size_t offset, int baseVertex)
+{
+	*push<DrawElementsCommand>(RenderCommandType::DRAW_ELEMENTS) = { mode, count, type, offset, baseVertex, true };
+}
+
+void RenderCommandList::drawElementsInstanced(GLenum mode, int count, GLenum type, size_t offset, int instances)
+{
+	*push<DrawElementsInstancedCommand>(RenderCommandType::DRAW_ELEMENTS_INSTANCED) = { mode, count, type, offset, instances };
+}
+
+void RenderCommandList::readPixels(int x, int y, int width, int height, void* dest)
+{
+	*push<ReadPixelsCommand>(RenderCommandType::READ_PIXELS) = { x, y, width, height, dest };
+}
+
+void RenderCommandList::beginQuery(GLenum target, unsigned int query)
+{
+	*push<BeginQueryCommand>(RenderCommandType::BEGIN_QUERY) = { target, query };
+}
+
+void RenderCommandList::endQuery(GLenum target)
+{
+	*push<EndQueryCommand>(RenderCommandType::END_QUERY) = { target };
+}
+
+RenderFrameStats RenderCommandList::execute(StreamBuffer* stream, GLStateCache* state)
+{
+	RenderFrameStats stats = {};
+
+	state->resetStats();
+
+	// First vertex of the last streamVertices() upload, or -1 if it didn't fit
+	int streamBase = -1;
+
+	size_t at = 0;
+
+	while (at < commands.size())
+	{
+		const RenderCommandHeader* header = (const RenderCommandHeader*)&commands[at];
+		const void* command = &commands[at + sizeof(RenderCommandHeader)];
+
+		switch (header->type)
+		{
+		case RenderCommandType::BEGIN_FRAME:
+			stream->beginFrame();
+
+			// Orphaning rebinds the stream buffer and leaves its target unbound
+			if (!stream->isPersistent())
+				state->assumeBuffer(GL_ARRAY_BUFFER, 0);
+			break;
+
+		case RenderCommandType::END_FRAME:
+			stream->endFrame();
+			stats.stream = stream->getStats();
+			stats.state = state->getStats();
+			break;
+
+		case RenderCommandType::CLEAR:
+			glClear(((const ClearCommand*)command)->mask);
+			break;
+
+		case RenderCommandType::VIEWPORT:
+		{
+			const ViewportCommand* c = (const ViewportCommand*)command;
+			glViewport(c->x, c->y, c->width, c->height);
+			break;
+		}
+
+		case RenderCommandType::BLEND:
+		{
+			const BlendCommand* c = (const BlendCommand*)command;
+			state->setBlend(c->enabled);
+
+			if (c->enabled)
+				state->blendFunc(c->src, c->dst);
+			break;
+		}
+
+		case RenderCommandType::USE_PROGRAM:
+			state->useProgram(((const UseProgramCommand*)command)->program);
+			break;
+
+		case RenderCommandType::UNIFORM_INT:
+		{
+			const UniformIntCommand* c = (const UniformIntCommand*)command;
+			glUniform1i(c->location, c->value);
+			break;
+		}
+
+		case RenderCommandType::UNIFORM_VEC2:
+		{
+			const UniformVec2Command* c = (const UniformVec2Command*)command;
+			glUniform2fv(c->location, 1, &c->value[0]);
+			break;
+		}
+
+		case RenderCommandType::UNIFORM_MAT4:
+		{
+			const UniformMat4Command* c = (const UniformMat4Command*)command;
+			glUniformMatrix4fv(c->location, 1, GL_FALSE, &c->value[0][0]);
+			break;
+		}
+
+		case RenderCommandType::BIND_VERTEX_ARRAY:
+			state->bindVertexArray(((const BindVertexArrayCommand*)command)->vao);
+			break;
+
+		case RenderCommandType::BIND_TEXTURE:
+		{
+			const BindTextureCommand* c = (const BindTextureCommand*)command;
+			state->bindTexture(c->unit, c->target, c->texture);
+			break;
+		}
+
+		case RenderCommandType::BUFFER_DATA:
+		{
+			const BufferDataCommand* c = (const BufferDataCommand*)command;
+			state->bindBuffer(c->target, c->buffer);
+			glBufferData(c->target, c->size, c->hasData ? &payload[c->payload] : NULL, c->usage);
+			break;
+		}
+
+		case RenderCommandType::BUFFER_SUB_DATA:
+		{
+			const BufferSubDataCommand* c = (const BufferSubDataCommand*)command;
+			state->bindBuffer(c->target, c->buffer);
+			glBufferSubData(c->target, c->offset, c->size, &payload[c->payload]);
+			break;
+		}
+
+		case RenderCommandType::TEX_SUB_IMAGE_2D:
+		{
+			const TexSubImage2DCommand* c = (const TexSubImage2DCommand*)command;
+			state->bindTexture(0, c->target, c->texture);
+			state->pixelStore(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(c->target, 0, c->x, c->y, c->width, c->height, c->format, c->type, &payload[c->payload]);
+			state->pixelStore(GL_UNPACK_ALIGNMENT, 4);
+			break;
+		}
+
+		case RenderCommandType::STREAM_VERTICES:
+		{
+			const StreamVerticesCommand* c = (const StreamVerticesCommand*)command;
+
+			StreamAllocation allocation = stream->allocate(c->size, c->stride);
+
+			if (allocation.data != NULL)
+			{
+				memcpy(allocation.data, &payload[c->payload], c->size);
+				stream->flush(allocation);
+
+				if (!stream->isPersistent())
+					state->assumeBuffer(GL_ARRAY_BUFFER, 0);
+
+				streamBase = (int)(allocation.offset / c->stride);
+			}
+			else
+			{
+				streamBase = -1;
+			}
+			break;
+		}
+
+		case RenderCommandType::DRAW_ARRAYS:
+		{
+			const DrawArraysCommand* c = (const DrawArraysCommand*)command;
+			glDrawArrays(c->mode, c->first, c->count);
+			stats.drawCalls++;
+			break;
+		}
+
+		case RenderCommandType::DRAW_ELEMENTS:
+		{
+			const DrawElementsCommand* c = (const DrawElementsCommand*)command;
+
+			if (!c->streamed)
+			{
+				glDrawElements(c->mode, c->count, c->type, (void*)c->offset);
+				stats.drawCalls++;
+			}
+			else if (streamBase >= 0)
+			{
+				glDrawElementsBaseVertex(c->mode, c->count, c->type, (void*)c->offset, streamBase + c->baseVertex);
+				stats.drawCalls++;
+			}
+			break;
+		}
+
+		case RenderCommandType::DRAW_ELEMENTS_INSTANCED:
+		{
+			const DrawElementsInstancedCommand* c = (const DrawElementsInstancedCommand*)command;
+			glDrawElementsInstanced(c->mode, c->count, c->type, (void*)c->offset, c->instances);
+			stats.drawCalls++;
+			break;
+		}
+
+		case RenderCommandType::READ_PIXELS:
+		{
+			const ReadPixelsCommand* c = (const ReadPixelsCommand*)command;
+			glReadPixels(c->x, c->y, c->width, c->height, GL_RGBA, GL_UNSIGNED_BYTE, c->dest);
+			break;
+		}
+
+		case RenderCommandType::BEGIN_QUERY:
+		{
+			const BeginQueryCommand* c = (const BeginQueryCommand*)command;
+			glBeginQuery(c->target, c->query);
+			break;
+		}
+
+		case RenderCommandType::END_QUERY:
+		{
+			const EndQueryCommand* c = (const EndQueryCommand*)command;
+			glEndQuery(c->target);
+			break;
+		}
+		}
+
+		stats.commands++;
+
+		at += header->size;
+	}
+
+	return stats;
+}
+
+size_t RenderCommandList::getCommandBytes()
+{
+	return commands.size();
+}
+
+size_t RenderCommandList::getPayloadBytes()
+{
+	return payload.size();
+}
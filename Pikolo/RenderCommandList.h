@@ -0,0 +1,142 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "GLStateCache.h"
+#include "NullGL.h"
+#include "StreamBuffer.h"
+#include "Uniform.h"
+
+enum class RenderCommandType : unsigned char
+{
+	BEGIN_FRAME, END_FRAME, CLEAR, VIEWPORT, BLEND,
+	USE_PROGRAM, UNIFORM_INT, UNIFORM_VEC2, UNIFORM_MAT4,
+	BIND_VERTEX_ARRAY, BIND_TEXTURE,
+	BUFFER_DATA, BUFFER_SUB_DATA, TEX_SUB_IMAGE_2D, STREAM_VERTICES,
+	DRAW_ARRAYS, DRAW_ELEMENTS, DRAW_ELEMENTS_INSTANCED,
+	READ_PIXELS, BEGIN_QUERY, END_QUERY
+};
+
+struct RenderCommandHeader {
+	RenderCommandType type;
+	unsigned int size;
+};
+
+struct EmptyCommand {};
+struct ClearCommand { GLbitfield mask; };
+struct ViewportCommand { int x, y, width, height; };
+struct BlendCommand { bool enabled; GLenum src, dst; };
+struct UseProgramCommand { unsigned int program; };
+struct UniformIntCommand { int location; int value; };
+struct UniformVec2Command { int location; glm::vec2 value; };
+struct UniformMat4Command { int location; glm::mat4 value; };
+struct BindVertexArrayCommand { unsigned int vao; };
+struct BindTextureCommand { unsigned int unit; GLenum target; unsigned int texture; };
+
+// Payloads are offsets into the list's payload arena, which may move as it grows
+struct BufferDataCommand { GLenum target; unsigned int buffer; GLenum usage; size_t size; size_t payload; bool hasData; };
+struct BufferSubDataCommand { GLenum target; unsigned int buffer; size_t offset; size_t size; size_t payload; };
+struct TexSubImage2DCommand { GLenum target; unsigned int texture; int x, y, width, height; GLenum format, type; size_t payload; };
+
+// Copies the payload into the stream buffer at replay time - following streamed draws are offset to it
+struct StreamVerticesCommand { size_t size; size_t stride; size_t payload; };
+
+struct DrawArraysCommand { GLenum mode; int first; int count; };
+struct DrawElementsCommand { GLenum mode; int count; GLenum type; size_t offset; int baseVertex; bool streamed; };
+struct DrawElementsInstancedCommand { GLenum mode; int count; GLenum type; size_t offset; int instances; };
+
+// Reads straight into the caller's memory at replay time
+struct ReadPixelsCommand { int x, y, width, height; void* dest; };
+
+struct BeginQueryCommand { GLenum target; unsigned int query; };
+struct EndQueryCommand { GLenum target; };
+
+// What replaying a list cost, filled in by execute()
+struct RenderFrameStats {
+
+	int commands;
+	int drawCalls;
+
+	StreamBufferStats stream;
+	GLStateStats state;
+
+	// What reached the null backend, when it's loaded - filled in by RenderThread rather than execute()
+	NullGLStats nullGL;
+};
+
+// A compact, recorded frame of GL work. The game side records into it without touching GL, and whichever
+// thread owns the context replays it with execute(). Storage is kept between frames, so recording doesn't
+// allocate once the list has grown to its working size.
+class RenderCommandList
+{
+private:
+
+	std::vector<unsigned char> commands;
+	std::vector<unsigned char> payload;
+
+#ifdef _DEBUG
+	// The program the last useProgram() recorded, which every uniform set has to belong to
+	unsigned int program;
+
+	template<typename T>
+	void validate(Uniform<T> uniform);
+#endif
+
+	template<typename T>
+	T* push(RenderCommandType type);
+
+	size_t pushPayload(const void* data, size_t size);
+
+public:
+	RenderCommandList();
+
+	// Empties the list but keeps its storage
+	void reset();
+
+	bool isEmpty();
+
+	void beginFrame();
+	void endFrame();
+
+	void clear(GLbitfield mask);
+	void viewport(int x, int y, int width, int height);
+	void blend(bool enabled, GLenum src, GLenum dst);
+
+	void useProgram(unsigned int program);
+	void setUniform(Uniform<int> uniform, int value);
+	void setUniform(Uniform<glm::vec2> uniform, const glm::vec2& value);
+	void setUniform(Uniform<glm::mat4> uniform, const glm::mat4& value);
+
+	void bindVertexArray(unsigned int vao);
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+	// Data is copied into the list, so the caller's memory can be reused straight away. NULL data allocates storage only.
+	void bufferData(GLenum target, unsigned int buffer, size_t size, const void* data, GLenum usage);
+	void bufferSubData(GLenum target, unsigned int buffer, size_t offset, size_t size, const void* data);
+
+	// data points at the first texel of a rectangle in an image rowLength texels wide
+	void texSubImage2D(GLenum target, unsigned int texture, int x, int y, int width, int height,
+		GLenum format, GLenum type, int texelSize, int rowLength, const void* data);
+
+	// Reserves size bytes of vertex data to fill in directly - the pointer is only valid until the next command is recorded
+	void* streamVertices(size_t size, size_t stride);
+
+	void drawArrays(GLenum mode, int first, int count);
+	void drawElements(GLenum mode, int count, GLenum type, size_t offset);
+	// Draws from the vertices of the last streamVertices() call
+	void drawStreamedElements(GLenum mode, int count, GLenum type, size_t offset, int baseVertex);
+	void drawElementsInstanced(GLenum mode, int count, GLenum type, size_t offset, int instances);
+
+	// Copies a rectangle of the back buffer as RGBA8 into dest, which must stay alive until the list has been replayed
+	void readPixels(int x, int y, int width, int height, void* dest);
+
+	void beginQuery(GLenum target, unsigned int query);
+	void endQuery(GLenum target);
+
+	// Replays every command on the calling thread, which must own the GL context. State changes go
+	// through the cache, so binds that wouldn't change anything are dropped.
+	RenderFrameStats execute(StreamBuffer* stream, GLStateCache* state);
+
+	size_t getCommandBytes();
+	size_t getPayloadBytes();
+};
@@ -0,0 +1,244 @@
+#include "stdafx.h"
+
+#include "RenderThread.h"
+
+static void accumulate(RenderFrameStats& total, const RenderFrameStats& frame)
+{
+	total.commands += frame.commands;
+	total.drawCalls += frame.drawCalls;
+
+	total.stream.bytesUploaded += frame.stream.bytesUploaded;
+	total.stream.stalls += frame.stream.stalls;
+	total.stream.stallTime += frame.stream.stallTime;
+	total.stream.failedAllocations += frame.stream.failedAllocations;
+
+	total.state.issued += frame.state.issued;
+	total.state.skipped += frame.state.skipped;
+
+	total.nullGL.calls += frame.nullGL.calls;
+	total.nullGL.drawCalls += frame.nullGL.drawCalls;
+	total.nullGL.stateChanges += frame.nullGL.stateChanges;
+	total.nullGL.uniformSets += frame.nullGL.uniformSets;
+	total.nullGL.bytesUploaded += frame.nullGL.bytesUploaded;
+}
+
+RenderThread::RenderThread(GLFWwindow* window, StreamBuffer* stream, FrameProfiler* profiler, bool threaded)
+{
+	this->window = window;
+	this->stream = stream;
+	this->profiler = profiler;
+	this->threaded = threaded;
+
+	uploader = NULL;
+
+	recording = 0;
+	submitted = 0;
+
+	pending = false;
+	running = false;
+
+	stats = {};
+	replayTime = 0.0;
+
+	totals = {};
+	framesReplayed = 0;
+}
+
+void RenderThread::setTextureUploader(TextureUploader* uploader)
+{
+	this->uploader = uploader;
+}
+
+void RenderThread::addShaderVariants(ShaderVariants* variants)
+{
+	shaderVariants.push_back(variants);
+}
+
+RenderThread::~RenderThread()
+{
+	stop();
+}
+
+void RenderThread::start()
+{
+	if (!threaded || running)
+		return;
+
+	running = true;
+
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent(NULL);
+
+	thread = std::thread(&RenderThread::run, this);
+
+#ifdef DEBUG_ON
+	printf("Render thread started...\n");
+#endif
+}
+
+void RenderThread::stop()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		running = false;
+	}
+
+	condition.notify_all();
+
+	thread.join();
+
+	glfwMakeContextCurrent(window);
+}
+
+void RenderThread::run()
+{
+	glfwMakeContextCurrent(window);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		condition.wait(lock, [this] { return pending || !running; });
+
+		if (!pending)
+			break;
+
+		int index = submitted;
+
+		lock.unlock();
+
+		replay(lists[index]);
+
+		lock.lock();
+
+		pending = false;
+
+		condition.notify_all();
+	}
+
+	lock.unlock();
+
+	glfwMakeContextCurrent(NULL);
+}
+
+void RenderThread::replay(RenderCommandList& list)
+{
+	double start = glfwGetTime();
+
+	// Inline, the main thread may have made GL calls of its own since the last frame
+	if (!threaded)
+		state.invalidate();
+
+	// The uploader binds buffers and textures behind the cache's back
+	if (uploader != NULL && uploader->poll())
+		state.invalidate();
+
+	// Ahead of the list, so the frame that asked for a variant already has it when it's next recorded
+	for (ShaderVariants* variants : shaderVariants)
+	{
+		if (variants->buildRequested())
+			state.invalidate();
+	}
+
+	// Only this thread writes it, and every submitted list is one frame
+	int frame = framesReplayed;
+
+	RenderFrameStats frameStats;
+
+	{
+		ProfileScope scope(profiler, frame, ProfileStage::REPLAY);
+
+		frameStats = list.execute(stream, &state);
+	}
+
+	{
+		ProfileScope scope(profiler, frame, ProfileStage::SWAP);
+
+		// Headless there's nothing to present, the frame just ends
+		if (window != NULL)
+			glfwSwapBuffers(window);
+		else if (isNullGLLoaded())
+			frameStats.nullGL = nullGLEndFrame();
+	}
+
+	// The previous frame's queries have had a whole frame to finish
+	if (profiler != NULL)
+		profiler->resolve(frame - (PROFILER_QUERY_FRAMES - 1));
+
+	list.reset();
+
+	double elapsed = glfwGetTime() - start;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stats = frameStats;
+	replayTime = elapsed;
+
+	accumulate(totals, frameStats);
+	framesReplayed++;
+}
+
+RenderCommandList* RenderThread::getCommands()
+{
+	return &lists[recording];
+}
+
+void RenderThread::submit()
+{
+	if (!threaded)
+	{
+		replay(lists[recording]);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// The other list is free once the previous frame has been replayed
+	condition.wait(lock, [this] { return !pending; });
+
+	submitted = recording;
+	recording ^= 1;
+
+	pending = true;
+
+	lock.unlock();
+
+	condition.notify_all();
+}
+
+RenderFrameStats RenderThread::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return stats;
+}
+
+double RenderThread::getReplayTime()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return replayTime;
+}
+
+RenderFrameStats RenderThread::getTotals()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return totals;
+}
+
+int RenderThread::getFramesReplayed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return framesReplayed;
+}
+
+bool RenderThread::isThreaded()
+{
+	return threaded;
+}
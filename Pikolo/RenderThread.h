@@ -0,0 +1,98 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "FrameProfiler.h"
+#include "GLStateCache.h"
+#include "RenderCommandList.h"
+#include "ShaderVariants.h"
+#include "StreamBuffer.h"
+#include "TextureUploader.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Owns the GL context and replays recorded frames. The game records frame N+1 into one list while the
+// render thread replays and swaps frame N from the other. In single-threaded mode the same list is replayed
+// inline by submit(), so both paths can be timed against each other.
+class RenderThread
+{
+private:
+
+	GLFWwindow* window;
+
+	StreamBuffer* stream;
+
+	FrameProfiler* profiler;
+
+	TextureUploader* uploader;
+
+	std::vector<ShaderVariants*> shaderVariants;
+
+	// Shadow of the context's state, only touched by whichever thread owns the context
+	GLStateCache state;
+
+	bool threaded;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	RenderCommandList lists[2];
+
+	// List the game is recording into, and the one handed to the render thread
+	int recording;
+	int submitted;
+
+	// A submitted list hasn't finished replaying yet
+	bool pending;
+	bool running;
+
+	RenderFrameStats stats;
+	double replayTime;
+
+	// Sums over every frame replayed since start
+	RenderFrameStats totals;
+	int framesReplayed;
+
+	void run();
+
+	// Execute, swap and empty the list - must be called on the thread owning the context
+	void replay(RenderCommandList& list);
+
+	RenderThread() {}
+
+public:
+	// window is NULL when running headless on the null backend. profiler may be NULL.
+	RenderThread(GLFWwindow* window, StreamBuffer* stream, FrameProfiler* profiler, bool threaded);
+	~RenderThread();
+
+	// Hands the context over to the render thread - no GL calls may be made on the calling thread until stop()
+	void start();
+
+	// Finishes any submitted frame and makes the context current on the calling thread again
+	void stop();
+
+	// Polled before each replay, so background texture loads progress on the thread owning the context. May be NULL.
+	void setTextureUploader(TextureUploader* uploader);
+
+	// Variants the game asks for without the context are built before each replay too
+	void addShaderVariants(ShaderVariants* variants);
+
+	// The list to record the next frame into
+	RenderCommandList* getCommands();
+
+	// Queue the recorded frame for replay and swap. Waits if the previous frame is still being replayed.
+	void submit();
+
+	// Stats and time taken by the last replayed frame
+	RenderFrameStats getStats();
+	double getReplayTime();
+
+	// Sums of every frame's stats, for benchmark reports - exact once stop() has returned
+	RenderFrameStats getTotals();
+	int getFramesReplayed();
+
+	bool isThreaded();
+};
@@ -6,10 +6,11 @@ compiles the shaders, creates a shader program which the shaders are linked
 to, then the program is validated and is ready for use via myProgram.use(),
 <draw-stuff-here> then calling myProgram.disable();
 
-Attributes and uniforms are stored in <string, int> maps and can be added
-via calls to addAttribute(<name-of-attribute>) and then the attribute
-index can be obtained via myProgram.attribute(<name-of-attribute>) - Uniforms
-work in the exact same way.
+Active attributes, uniforms and uniform blocks are reflected into tables
+sorted by name when the program links, so the attribute index can be
+obtained via myProgram.attribute(<name-of-attribute>) - Uniforms work in
+the exact same way, and addUniform<type>(<name-of-uniform>) also returns a
+typed handle that setUniform() takes without any lookup.
 ***/
 
 #ifndef SHADER_PROGRAM_HPP
@@ -18,13 +19,47 @@ work in the exact same way.
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <map>
+#include <mutex>
+#include <set>
+#include <vector>
 
 #include "stdafx.h"
+#include "ProgramBinaryCache.h"
+#include "Uniform.h"
 
 #include <glm.hpp>
 
 
+// One active uniform, attribute or uniform block, as the GL reported it when the program was linked
+struct ShaderBinding {
+
+	// Arrays are listed once, without the [0] the GL puts on the end
+	std::string name;
+
+	// GL_FLOAT_VEC2, GL_SAMPLER_2D and so on - 0 for blocks, and for anything the GL didn't report
+	GLenum type;
+
+	// Elements in an array, otherwise 1 - a block's size in bytes
+	int size;
+
+	// Uniform or attribute location, or block index
+	int location;
+};
+
+// Totals over every program built so far, for reporting startup costs
+struct ShaderBuildStats {
+
+	int programs;
+
+	// Programs linked straight from the binary cache rather than compiled
+	int fromBinary;
+
+	// Seconds spent compiling, linking or loading binaries
+	double seconds;
+};
+
 class ShaderProgram
 {
 private:
@@ -45,11 +80,13 @@ private:
 	// How many shaders are attached to the shader program
 	GLuint shaderCount;
 
-	// Map of attributes and their binding locations
-	std::map<std::string, int> attributeMap;
+	// Everything the program uses, reflected after linking and sorted by name
+	std::vector<ShaderBinding> attributes;
+	std::vector<ShaderBinding> uniforms;
+	std::vector<ShaderBinding> blocks;
 
-	// Map of uniforms and their binding locations
-	std::map<std::string, int> uniformMap;
+	// The uniforms again, sorted by location for the debug checks on every set
+	std::vector<ShaderBinding> uniformsByLocation;
 
 	// Has this shader program been initialised?
 	bool initialised;
@@ -119,6 +156,65 @@ private:
 	// Note: Rather than returning a boolean as a success/fail status we'll just consider
 	// a failure here to be an unrecoverable error and throw a runtime_error.
 	void initialise(std::string vertexShaderSource, std::string fragmentShaderSource)
+	{
+		double start = glfwGetTime();
+
+		// A cached binary for exactly this source and driver skips compiling and linking altogether
+		ProgramBinaryCache* cache = binaryCache();
+
+		std::uint64_t key = 0;
+		bool fromBinary = false;
+
+		if (cache != NULL && cache->isSupported())
+		{
+			key = cache->key(vertexShaderSource, fragmentShaderSource);
+			fromBinary = cache->load(key, programId);
+		}
+
+		if (!fromBinary)
+		{
+			link(vertexShaderSource, fragmentShaderSource);
+
+			if (cache != NULL && cache->isSupported())
+			{
+				cache->store(key, programId);
+			}
+		}
+
+		// Find out what the program actually uses before anything looks it up
+		reflect();
+
+		// Programs declaring the per-frame block read it from the shared buffer, so no per-program camera uniforms are needed
+		bindUniformBlock(FRAME_UNIFORM_BLOCK, FRAME_UNIFORM_BINDING);
+
+		// Likewise the light lists, which are bound to the same units for everyone
+		bindSampler(LIGHT_SAMPLER_LIGHTS, LIGHT_UNIT_LIGHTS);
+		bindSampler(LIGHT_SAMPLER_GRID, LIGHT_UNIT_GRID);
+		bindSampler(LIGHT_SAMPLER_INDICES, LIGHT_UNIT_INDICES);
+		bindSampler(ANIMATION_SAMPLER, ANIMATION_UNIT);
+		bindSampler(TILE_MAP_SAMPLER, TILE_MAP_UNIT);
+
+		validateProgram();
+
+		double seconds = glfwGetTime() - start;
+
+		ShaderBuildStats& stats = buildStats();
+
+		stats.programs++;
+		stats.fromBinary += fromBinary ? 1 : 0;
+		stats.seconds += seconds;
+
+		if (DEBUG)
+		{
+			std::cout << "Shader program " << (fromBinary ? "loaded from the binary cache" : "built from source") << " in " << (seconds * 1000.0) << " ms." << std::endl;
+		}
+
+		// Finally, the shader program is initialised
+		initialised = true;
+	}
+
+	// Private method to compile and link the program from source
+	void link(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
 	{
 		// Compile the shaders and return their id values
 		vertexShaderId = compileShader(vertexShaderSource, GL_VERTEX_SHADER);
@@ -128,6 +224,12 @@ private:
 		glAttachShader(programId, vertexShaderId);
 		glAttachShader(programId, fragmentShaderId);
 
+		// Let the cache ask for the binary once it's linked
+		if (binaryCache() != NULL)
+		{
+			binaryCache()->prepare(programId);
+		}
+
 		// Link the shader program - details are placed in the program info log
 		glLinkProgram(programId);
 
@@ -150,11 +252,17 @@ private:
 		{
 			throw std::runtime_error("Shader program link failed: " + getInfoLog(ObjectType::PROGRAM, programId));
 		}
+	}
 
-		// Validate the shader program
+	// Private method to validate the program against the current GL state - debug builds only, and only
+	// once every sampler has its unit, since samplers of different types sharing one (they all start on
+	// unit 0) fail validation. The result depends on whatever else is bound at the time, so a failure is
+	// logged rather than thrown.
+	void validateProgram()
+	{
+#ifdef _DEBUG
 		glValidateProgram(programId);
 
-		// Check the validation status and throw a runtime_error if program validation failed
 		GLint programValidatationStatus;
 		glGetProgramiv(programId, GL_VALIDATE_STATUS, &programValidatationStatus);
 		if (programValidatationStatus == GL_TRUE)
@@ -166,15 +274,244 @@ private:
 		}
 		else
 		{
-			throw std::runtime_error("Shader program validation failed: " + getInfoLog(ObjectType::PROGRAM, programId));
+			std::cout << "Shader program validation failed: " << getInfoLog(ObjectType::PROGRAM, programId) << std::endl;
 		}
+#endif
+	}
 
-		// Finally, the shader program is initialised
-		initialised = true;
+	// Private accessors for the cache every program is built through (NULL builds from source every
+	// time), and the running totals
+	static ProgramBinaryCache*& binaryCache()
+	{
+		static ProgramBinaryCache* cache = NULL;
+
+		return cache;
+	}
+
+	// Private accessor for every live program by GL name, so debug builds can check a recorded uniform set
+	// against the program it will be made on. Programs can be built on either thread, hence the lock.
+	static std::map<GLuint, ShaderProgram*>& registry(std::unique_lock<std::mutex>& lock)
+	{
+		static std::mutex mutex;
+		static std::map<GLuint, ShaderProgram*> programs;
+
+		lock = std::unique_lock<std::mutex>(mutex);
+
+		return programs;
+	}
+
+	static ShaderBuildStats& buildStats()
+	{
+		static ShaderBuildStats stats = {};
+
+		return stats;
 	}
 
-	// Private method to load the shader source code from a file
+	// Private method to fill the binding tables from the linked program - one pass over each kind of
+	// resource, so later lookups are a binary search with no GL round trip
+	void reflect()
+	{
+		GLint count = 0;
+		GLint maxLength = 0;
+
+		std::vector<GLchar> name;
+
+		glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+
+		for (GLuint i = 0; i < (GLuint)count; i++)
+		{
+			GLint size;
+			GLenum type;
+			GLint blockIndex;
+
+			glGetActiveUniform(programId, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+			glGetActiveUniformsiv(programId, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+
+			// Block members are set through the block's buffer, never one at a time
+			if (blockIndex == -1)
+			{
+				uniforms.push_back({ baseName(name.data()), type, size, glGetUniformLocation(programId, name.data()) });
+			}
+		}
+
+		glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+
+		for (GLuint i = 0; i < (GLuint)count; i++)
+		{
+			GLint size;
+			GLenum type;
+
+			glGetActiveAttrib(programId, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+
+			// Built-ins like gl_VertexID are listed too, but have no location
+			GLint location = glGetAttribLocation(programId, name.data());
+
+			if (location != -1)
+			{
+				attributes.push_back({ baseName(name.data()), type, size, location });
+			}
+		}
+
+		glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+
+		for (GLuint i = 0; i < (GLuint)count; i++)
+		{
+			GLint dataSize;
+
+			glGetActiveUniformBlockName(programId, i, (GLsizei)name.size(), NULL, name.data());
+			glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+
+			blocks.push_back({ name.data(), 0, dataSize, (int)i });
+		}
+
+		auto byName = [](const ShaderBinding& a, const ShaderBinding& b) { return a.name < b.name; };
+
+		std::sort(uniforms.begin(), uniforms.end(), byName);
+		std::sort(attributes.begin(), attributes.end(), byName);
+		std::sort(blocks.begin(), blocks.end(), byName);
+
+		indexUniforms();
+
+		if (DEBUG)
+		{
+			std::cout << "Shader program uses " << uniforms.size() << " uniforms, " << attributes.size() << " attributes and " << blocks.size() << " uniform blocks:" << std::endl;
+
+			for (const ShaderBinding& binding : uniforms)
+			{
+				std::cout << "  uniform " << binding.name << " - type 0x" << std::hex << binding.type << std::dec << ", size " << binding.size << ", location " << binding.location << std::endl;
+			}
+
+			for (const ShaderBinding& binding : attributes)
+			{
+				std::cout << "  attribute " << binding.name << " - type 0x" << std::hex << binding.type << std::dec << ", size " << binding.size << ", location " << binding.location << std::endl;
+			}
+
+			for (const ShaderBinding& binding : blocks)
+			{
+				std::cout << "  block " << binding.name << " - " << binding.size << " bytes, index " << binding.location << std::endl;
+			}
+		}
+	}
+
+	// Private method to strip the [0] off an array's name
+	static std::string baseName(const std::string& name)
+	{
+		size_t bracket = name.find('[');
+
+		return bracket == std::string::npos ? name : name.substr(0, bracket);
+	}
+
+	// Private method to binary search a table by name - NULL if it isn't there
+	static const ShaderBinding* findBinding(const std::vector<ShaderBinding>& table, const std::string& name)
+	{
+		auto it = std::lower_bound(table.begin(), table.end(), name, [](const ShaderBinding& binding, const std::string& n) { return binding.name < n; });
+
+		return (it != table.end() && it->name == name) ? &*it : NULL;
+	}
+
+	// Private method to add a binding the GL didn't report, keeping the table sorted
+	static const ShaderBinding* insertBinding(std::vector<ShaderBinding>& table, const ShaderBinding& binding)
+	{
+		auto it = std::lower_bound(table.begin(), table.end(), binding, [](const ShaderBinding& a, const ShaderBinding& b) { return a.name < b.name; });
+
+		return &*table.insert(it, binding);
+	}
+
+	// Private method to rebuild the by-location copy of the uniform table after it changes
+	void indexUniforms()
+	{
+		uniformsByLocation = uniforms;
+
+		std::sort(uniformsByLocation.begin(), uniformsByLocation.end(), [](const ShaderBinding& a, const ShaderBinding& b) { return a.location < b.location; });
+	}
+
+	// Private methods saying whether a uniform of a GL type can be set from a value of the pointed-to C++
+	// type. Samplers are set from ints, and a type of 0 (nothing reflected) is trusted.
+	static bool acceptsType(GLenum type, const int*)
+	{
+		switch (type)
+		{
+		case 0:
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_2D:
+		case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool acceptsType(GLenum type, const float*) { return type == 0 || type == GL_FLOAT; }
+	static bool acceptsType(GLenum type, const glm::vec2*) { return type == 0 || type == GL_FLOAT_VEC2; }
+	static bool acceptsType(GLenum type, const glm::vec3*) { return type == 0 || type == GL_FLOAT_VEC3; }
+	static bool acceptsType(GLenum type, const glm::vec4*) { return type == 0 || type == GL_FLOAT_VEC4; }
+	static bool acceptsType(GLenum type, const glm::mat2*) { return type == 0 || type == GL_FLOAT_MAT2; }
+	static bool acceptsType(GLenum type, const glm::mat3*) { return type == 0 || type == GL_FLOAT_MAT3; }
+	static bool acceptsType(GLenum type, const glm::mat4*) { return type == 0 || type == GL_FLOAT_MAT4; }
+
+	// Private method checking a set against the table in debug builds - setting a location this program
+	// doesn't have, or with a type the uniform doesn't take, throws instead of going silently wrong.
+	// Compiles to nothing otherwise.
+	template<typename T>
+	void validate(int location)
+	{
+#ifdef _DEBUG
+		auto it = std::lower_bound(uniformsByLocation.begin(), uniformsByLocation.end(), location, [](const ShaderBinding& binding, int l) { return binding.location < l; });
+
+		if (it != uniformsByLocation.end() && it->location == location)
+		{
+			if (!acceptsType(it->type, (const T*)NULL))
+			{
+				throw std::runtime_error("Uniform " + it->name + " set with a value of the wrong type.");
+			}
+
+			return;
+		}
+
+		throw std::runtime_error("Uniform location " + std::to_string(location) + " isn't used by this shader program.");
+#endif
+	}
+
+	// Private method checking a set through a handle - which also has to come from this program
+	template<typename T>
+	void validate(Uniform<T> handle)
+	{
+#ifdef _DEBUG
+		if (handle.program != programId)
+		{
+			throw std::runtime_error("Uniform handle from program " + std::to_string(handle.program) + " set on program " + std::to_string(programId) + ".");
+		}
+#endif
+		validate<T>(handle.location);
+	}
+
+	// Private method to load the shader source code from a file, expanding includes
 	std::string loadShaderFromFile(const std::string filename)
+	{
+		std::set<std::string> included;
+
+		return loadShaderFromFile(filename, included);
+	}
+
+	// Lines of the form #include "name" are replaced by that file, looked up next to the including one.
+	// Each file is only pulled in once, so shared snippets can include what they depend on.
+	std::string loadShaderFromFile(const std::string filename, std::set<std::string>& included)
 	{
 		// Create an input filestream and attempt to open the specified file
 		std::ifstream file(filename.c_str());
@@ -194,8 +531,33 @@ private:
 		// Now that we've read the file we can close it
 		file.close();
 
-		// Finally, convert the stringstream into a string and return it
-		return stream.str();
+		std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+		std::string source;
+		std::string line;
+
+		while (std::getline(stream, line))
+		{
+			size_t open = line.find('"');
+			size_t close = line.rfind('"');
+
+			if (line.compare(0, 9, "#include ") == 0 && open != std::string::npos && close > open)
+			{
+				std::string path = directory + line.substr(open + 1, close - open - 1);
+
+				if (included.insert(path).second)
+				{
+					source += loadShaderFromFile(path, included) + "\n";
+				}
+			}
+			else
+			{
+				source += line + "\n";
+			}
+		}
+
+		// Finally, return the expanded source
+		return source;
 	}
 
 	// Private method to return the current shader program info log as a string
@@ -242,10 +604,14 @@ public:
 		// Generate a unique Id / handle for the shader program
 		// Note: We MUST have a valid rendering context before generating the programId or we'll segfault!
 		programId = glCreateProgram();
-		glUseProgram(programId);
 
 		// Initially, we have zero shaders attached to the program
 		shaderCount = 0;
+
+#ifdef _DEBUG
+		std::unique_lock<std::mutex> lock;
+		registry(lock)[programId] = this;
+#endif
 	}
 
 	// Destructor
@@ -254,6 +620,43 @@ public:
 		// Delete the shader program from the graphics card memory to
 		// free all the resources it's been using
 		glDeleteProgram(programId);
+
+#ifdef _DEBUG
+		std::unique_lock<std::mutex> lock;
+		registry(lock).erase(programId);
+#endif
+	}
+
+	// Method to set the binary cache programs initialised from here on are built through - NULL turns it off
+	static void setBinaryCache(ProgramBinaryCache* cache)
+	{
+		binaryCache() = cache;
+	}
+
+	// Method to return the totals over every program built so far
+	static ShaderBuildStats getBuildStats()
+	{
+		return buildStats();
+	}
+
+	// Method to check a set recorded through a handle against the table of the program the handle came from,
+	// as setUniform() does for direct sets - debug builds only. Compiles to nothing otherwise.
+	template<typename T>
+	static void validateRecorded(Uniform<T> handle)
+	{
+#ifdef _DEBUG
+		std::unique_lock<std::mutex> lock;
+		std::map<GLuint, ShaderProgram*>& programs = registry(lock);
+
+		auto it = programs.find(handle.program);
+
+		if (it == programs.end())
+		{
+			throw std::runtime_error("Uniform location " + std::to_string(handle.location) + " recorded for program " + std::to_string(handle.program) + ", which doesn't exist.");
+		}
+
+		it->second->validate(handle);
+#endif
 	}
 
 	// Method to initialise a shader program from shaders provided as files
@@ -266,6 +669,35 @@ public:
 		initialise(vertexShaderSource, fragmentShaderSource);
 	}
 
+	// Method to initialise a shader program from shaders provided as files, with extra lines (usually
+	// #defines) put in straight after each file's #version
+	void initFromFiles(std::string vertexShaderFilename, std::string fragmentShaderFilename, const std::string& defines)
+	{
+		std::string vertexShaderSource = injectDefines(loadShaderFromFile(vertexShaderFilename), defines);
+		std::string fragmentShaderSource = injectDefines(loadShaderFromFile(fragmentShaderFilename), defines);
+
+		initialise(vertexShaderSource, fragmentShaderSource);
+	}
+
+	// Method to insert lines after a source's #version, which has to stay first
+	static std::string injectDefines(const std::string& source, const std::string& defines)
+	{
+		if (defines.empty())
+		{
+			return source;
+		}
+
+		size_t version = source.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+
+		if (lineEnd == std::string::npos)
+		{
+			return defines + source;
+		}
+
+		return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+	}
+
 	// Method to initialise a shader program from shaders provided as strings
 	void initFromStrings(std::string vertexShaderSource, std::string fragmentShaderSource)
 	{
@@ -288,189 +720,334 @@ public:
 		}
 	}
 
+	// Method to return the GL name of the program, for recording into command lists
+	GLuint getId()
+	{
+		return programId;
+	}
+
 	// Method to disable the shader - we'll also suggest this for inlining
 	inline void disable()
 	{
 		glUseProgram(0);
 	}
 
-	// Method to return the bound location of a named attribute, or -1 if the attribute was not found
-	GLuint attribute(const std::string attributeName)
+	// Method to return the bound location of a named attribute - throws if the program doesn't use it
+	GLuint attribute(const std::string& attributeName)
 	{
-		// You could do this method with the single line:
-		//
-		//		return attributeMap[attribute];
-		//
-		// BUT, if you did, and you asked it for a named attribute which didn't exist
-		// like: attributeMap["FakeAttrib"] then the method would return an invalid
-		// value which will likely cause the program to segfault. So we're making sure
-		// the attribute asked for exists, and if it doesn't then we alert the user & bail.
-
-		// Create an iterator to look through our attribute map (only create iterator on first run -
-		// reuse it for all further calls).
-		static std::map<std::string, int>::const_iterator attributeIter;
-
-		// Try to find the named attribute
-		attributeIter = attributeMap.find(attributeName);
+		const ShaderBinding* binding = findBinding(attributes, attributeName);
 
 		// Not found? Bail.
-		if (attributeIter == attributeMap.end())
+		if (binding == NULL)
 		{
 			throw std::runtime_error("Could not find attribute in shader program: " + attributeName);
 		}
 
-		// Otherwise return the attribute location from the attribute map
-		return attributeMap[attributeName];
+		return binding->location;
 	}
 
-	// Method to returns the bound location of a named uniform
-	GLuint uniform(const std::string uniformName)
+	// Method to return the bound location of a named uniform - throws if the program doesn't use it. Every
+	// active uniform is found, whether or not it was added. This is a search, so per-draw code should hold
+	// on to the handle addUniform() returned instead.
+	GLuint uniform(const std::string& uniformName)
 	{
-		// Note: You could do this method with the single line:
-		//
-		// 		return uniformLocList[uniform];
-		//
-		// But we're not doing that. Explanation in the attribute() method above.
-
-		// Create an iterator to look through our uniform map (only create iterator on first run -
-		// reuse it for all further calls).
-		static std::map<std::string, int>::const_iterator uniformIter;
-
-		// Try to find the named uniform
-		uniformIter = uniformMap.find(uniformName);
+		const ShaderBinding* binding = findBinding(uniforms, uniformName);
 
 		// Found it? Great - pass it back! Didn't find it? Alert user and halt.
-		if (uniformIter == uniformMap.end())
+		if (binding == NULL)
 		{
 			throw std::runtime_error("Could not find uniform in shader program: " + uniformName);
 		}
 
-		// Otherwise return the attribute location from the uniform map
-		return uniformMap[uniformName];
+		return binding->location;
+	}
+
+	// Method to return what linking found - uniforms, attributes and blocks, each sorted by name
+	const std::vector<ShaderBinding>& getUniforms()
+	{
+		return uniforms;
+	}
+
+	const std::vector<ShaderBinding>& getAttributes()
+	{
+		return attributes;
+	}
+
+	const std::vector<ShaderBinding>& getUniformBlocks()
+	{
+		return blocks;
 	}
 
 	// Method to add an attribute to the shader and return the bound location
-	int addAttribute(const std::string attributeName)
+	int addAttribute(const std::string& attributeName)
 	{
-		// Add the attribute location value for the attributeName key
-		attributeMap[attributeName] = glGetAttribLocation(programId, attributeName.c_str());
+		const ShaderBinding* binding = findBinding(attributes, attributeName);
 
-		// Check to ensure that the shader contains an attribute with this name
-		if (attributeMap[attributeName] == -1)
+		// Not reflected - ask the GL directly, which only finds it if it's really there
+		if (binding == NULL)
 		{
-			throw std::runtime_error("Could not add attribute: " + attributeName + " - location returned -1.");
-		}
-		else // Valid attribute location? Inform user if we're in debug mode.
-		{
-			if (DEBUG)
+			int location = glGetAttribLocation(programId, attributeName.c_str());
+
+			if (location == -1)
 			{
-				std::cout << "Attribute " << attributeName << " bound to location: " << attributeMap[attributeName] << std::endl;
+				throw std::runtime_error("Could not add attribute: " + attributeName + " - location returned -1.");
 			}
+
+			binding = insertBinding(attributes, { attributeName, 0, 1, location });
+		}
+
+		if (DEBUG)
+		{
+			std::cout << "Attribute " << attributeName << " bound to location: " << binding->location << std::endl;
 		}
 
 		// Return the attribute location
-		return attributeMap[attributeName];
+		return binding->location;
 	}
 
-	// Method to add a uniform to the shader and return the bound location
-	int addUniform(const std::string uniformName)
+	// Method to attach a named uniform block to a binding point - returns false if the program doesn't use the block
+	bool bindUniformBlock(const std::string blockName, GLuint binding)
 	{
-		// Add the uniform location value for the uniformName key
-		uniformMap[uniformName] = glGetUniformLocation(programId, uniformName.c_str());
+		GLuint blockIndex = glGetUniformBlockIndex(programId, blockName.c_str());
 
-		// Check to ensure that the shader contains a uniform with this name
-		if (uniformMap[uniformName] == -1)
+		if (blockIndex == GL_INVALID_INDEX)
 		{
-			throw std::runtime_error("Could not add uniform: " + uniformName + " - location returned -1.");
+			return false;
 		}
-		else // Valid uniform location? Inform user if we're in debug mode.
+
+		glUniformBlockBinding(programId, blockIndex, binding);
+
+		if (DEBUG)
 		{
-			if (DEBUG)
+			std::cout << "Uniform block " << blockName << " bound to binding point: " << binding << std::endl;
+		}
+
+		return true;
+	}
+
+	// Method to point a sampler uniform at a texture unit - returns false if the program doesn't use the sampler.
+	// Only call this while setting up, since it changes the bound program behind any command list's back.
+	bool bindSampler(const std::string samplerName, GLint unit)
+	{
+		GLint location = glGetUniformLocation(programId, samplerName.c_str());
+
+		if (location == -1)
+		{
+			return false;
+		}
+
+		glUseProgram(programId);
+		glUniform1i(location, unit);
+		glUseProgram(0);
+
+		if (DEBUG)
+		{
+			std::cout << "Sampler " << samplerName << " bound to texture unit: " << unit << std::endl;
+		}
+
+		return true;
+	}
+
+	// Method to add a uniform to the shader and return a handle to its location, typed by the value it
+	// takes (samplers are ints). The location comes from the table built at link time, and setting the
+	// uniform through the handle needs no string work at all. Throws if the uniform's type doesn't match.
+	template<typename T>
+	Uniform<T> addUniform(const std::string& uniformName)
+	{
+		const ShaderBinding* binding = findBinding(uniforms, uniformName);
+
+		// Not reflected - ask the GL directly, which only finds it if it's really there
+		if (binding == NULL)
+		{
+			int location = glGetUniformLocation(programId, uniformName.c_str());
+
+			if (location == -1)
 			{
-				std::cout << "Uniform " << uniformName << " bound to location: " << uniformMap[uniformName] << std::endl;
+				throw std::runtime_error("Could not add uniform: " + uniformName + " - location returned -1.");
 			}
+
+			binding = insertBinding(uniforms, { uniformName, 0, 1, location });
+
+			indexUniforms();
 		}
 
-		// Return the uniform location
-		return uniformMap[uniformName];
+		if (!acceptsType(binding->type, (const T*)NULL))
+		{
+			throw std::runtime_error("Could not add uniform: " + uniformName + " - it doesn't take that type.");
+		}
+
+		if (DEBUG)
+		{
+			std::cout << "Uniform " << uniformName << " bound to location: " << binding->location << std::endl;
+		}
+
+		// Return the handle
+		return Uniform<T>(programId, binding->location);
+	}
+
+	//Method to set the value of an integer or sampler uniform through its handle
+	void setUniform(Uniform<int> handle, int i)
+	{
+		validate(handle);
+
+		glUniform1i(handle.location, i);
+	}
+
+	//Method to set the value of a float uniform through its handle
+	void setUniform(Uniform<float> handle, float f)
+	{
+		validate(handle);
+
+		glUniform1f(handle.location, f);
+	}
+
+	//Method to set the value of a vec2 uniform through its handle
+	void setUniform(Uniform<glm::vec2> handle, const glm::vec2 &value)
+	{
+		validate(handle);
+
+		glUniform2fv(handle.location, 1, &value[0]);
+	}
+
+	//Method to set the value of a vec3 uniform through its handle
+	void setUniform(Uniform<glm::vec3> handle, const glm::vec3 &value)
+	{
+		validate(handle);
+
+		glUniform3fv(handle.location, 1, &value[0]);
+	}
+
+	//Method to set the value of a vec4 uniform through its handle
+	void setUniform(Uniform<glm::vec4> handle, const glm::vec4 &value)
+	{
+		validate(handle);
+
+		glUniform4fv(handle.location, 1, &value[0]);
+	}
+
+	//Method to set the value of a mat4 uniform through its handle
+	void setUniform(Uniform<glm::mat4> handle, const glm::mat4 &value)
+	{
+		validate(handle);
+
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, &value[0][0]);
 	}
 	
 	//Method to set the value of a boolean uniform
 	void setUniform(const std::string & uniformName, bool b)
 	{
-		glUniform1i(uniform(uniformName), (int)b);
+		int location = uniform(uniformName);
+		validate<int>(location);
+
+		glUniform1i(location, (int)b);
 	}
 
 	//Method to set the value of an integer uniform
 	void setUniform(const std::string & uniformName, int i)
 	{
-		glUniform1i(uniform(uniformName), i);
+		int location = uniform(uniformName);
+		validate<int>(location);
+
+		glUniform1i(location, i);
 	}
 
 	//Method to set the value of a float uniform
 	void setUniform(const std::string & uniformName, float f)
 	{
-		glUniform1f(uniform(uniformName), f);
+		int location = uniform(uniformName);
+		validate<float>(location);
+
+		glUniform1f(location, f);
 	}
 
 	//Method to set the value of a 2fv uniform
 	void setUniform(const std::string & uniformName, const glm::vec2 &value)
 	{
-		glUniform2fv(uniform(uniformName), 1, &value[0]);
+		int location = uniform(uniformName);
+		validate<glm::vec2>(location);
+
+		glUniform2fv(location, 1, &value[0]);
 	}
 
 	//Method to set the value of a 2f uniform
 	void setUniform(const std::string & uniformName, float x, float y)
 	{
-		glUniform2f(uniform(uniformName), x, y);
+		int location = uniform(uniformName);
+		validate<glm::vec2>(location);
+
+		glUniform2f(location, x, y);
 	}
 
 	//Method to set the value of a 3fv uniform
 	void setUniform(const std::string & uniformName, const glm::vec3 &value)
 	{
-		glUniform3fv(uniform(uniformName), 1, &value[0]);
+		int location = uniform(uniformName);
+		validate<glm::vec3>(location);
+
+		glUniform3fv(location, 1, &value[0]);
 	}
 
 	//Method to set the value of a 3f uniform
 	void setUniform(const std::string & uniformName, float x, float y, float z)
 	{
-		glUniform3f(uniform(uniformName), x, y, z);
+		int location = uniform(uniformName);
+		validate<glm::vec3>(location);
+
+		glUniform3f(location, x, y, z);
 	}
 
 	//Method to set the value of a colour uniform
 	void setUniform(const std::string & uniformName, Colour c)
 	{
-		glUniform3f(uniform(uniformName), c.r, c.g, c.b);
+		int location = uniform(uniformName);
+		validate<glm::vec3>(location);
+
+		glUniform3f(location, c.r, c.g, c.b);
 	}
 
 	//Method to set the value of a 4fv uniform
 	void setUniform(const std::string & uniformName, const glm::vec4 &value)
 	{
-		glUniform4fv(uniform(uniformName), 1, &value[0]);
+		int location = uniform(uniformName);
+		validate<glm::vec4>(location);
+
+		glUniform4fv(location, 1, &value[0]);
 	}
 
 	//Method to set the value of a 4f uniform
 	void setUniform(const std::string & uniformName, float x, float y, float z, float w)
 	{
-		glUniform4f(uniform(uniformName), x, y, z, w);
+		int location = uniform(uniformName);
+		validate<glm::vec4>(location);
+
+		glUniform4f(location, x, y, z, w);
 	}
 
 	//Method to set the value of a mat2 uniform
 	void setUniform(const std::string & uniformName, const glm::mat2 &value)
 	{
-		glUniformMatrix2fv(uniform(uniformName), 1, GL_FALSE, &value[0][0]);
+		int location = uniform(uniformName);
+		validate<glm::mat2>(location);
+
+		glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
 	}
 
 	//Method to set the value of a mat3 uniform
 	void setUniform(const std::string & uniformName, const glm::mat3 &value)
 	{
-		glUniformMatrix3fv(uniform(uniformName), 1, GL_FALSE, &value[0][0]);
+		int location = uniform(uniformName);
+		validate<glm::mat3>(location);
+
+		glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
 	}
 
 	//Method to set the value of a mat4 uniform
 	void setUniform(const std::string & uniformName, const glm::mat4 &value)
 	{
-		glUniformMatrix4fv(uniform(uniformName), 1, GL_FALSE, &value[0][0]);
+		int location = uniform(uniformName);
+		validate<glm::mat4>(location);
+
+		glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 	}
 	
 }; // End of class
@@ -0,0 +1,101 @@
+#include "stdafx.h"
+
+#include "ShaderVariants.h"
+
+const char* SHADER_FEATURE_NAMES[SHADER_FEATURE_COUNT] = { "LIGHTING", "TINT", "ANIMATED" };
+
+ShaderVariants::ShaderVariants(const std::string& vertexFilename, const std::string& fragmentFilename, unsigned int supported)
+{
+	this->vertexFilename = vertexFilename;
+	this->fragmentFilename = fragmentFilename;
+	this->supported = supported;
+
+	programs.resize(1 << SHADER_FEATURE_COUNT, NULL);
+
+	requested = 0;
+	builtCount = 0;
+
+	// The fallback for when a variant can't be built on the spot
+	build(supported);
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	for (ShaderProgram* program : programs)
+		delete program;
+}
+
+// Called with the mutex held
+ShaderProgram* ShaderVariants::build(unsigned int key)
+{
+	ShaderProgram* program = new ShaderProgram();
+
+	program->initFromFiles(vertexFilename, fragmentFilename, defines(key));
+
+	programs[key] = program;
+	builtCount++;
+
+#ifdef DEBUG_ON
+	printf("Built %s variant 0x%x of %s, %d variants so far\n", key == supported ? "full" : "reduced", key, fragmentFilename.c_str(), builtCount);
+#endif
+
+	return program;
+}
+
+ShaderProgram* ShaderVariants::get(unsigned int features)
+{
+	unsigned int key = features & supported;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (programs[key] != NULL)
+		return programs[key];
+
+	// Headless, the null backend works from any thread, but has no context either - it's built at the next replay like the rest
+	if (glfwGetCurrentContext() == NULL)
+	{
+		requested |= 1u << key;
+
+		return programs[supported];
+	}
+
+	return build(key);
+}
+
+bool ShaderVariants::buildRequested()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (requested == 0)
+		return false;
+
+	for (unsigned int key = 0; key < programs.size(); key++)
+	{
+		if ((requested & (1u << key)) && programs[key] == NULL)
+			build(key);
+	}
+
+	requested = 0;
+
+	return true;
+}
+
+int ShaderVariants::getVariantCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return builtCount;
+}
+
+std::string ShaderVariants::defines(unsigned int features)
+{
+	std::string lines;
+
+	for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+	{
+		if (features & (1u << i))
+			lines += std::string("#define ") + SHADER_FEATURE_NAMES[i] + "\n";
+	}
+
+	return lines;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "ShaderProgram.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Feature switches a shader source can declare - bit i of a variant key defines SHADER_FEATURE_NAMES[i]
+// for that variant. Every switch is an optimisation: leaving one on when it isn't needed gives the same
+// picture, just slower.
+enum ShaderFeature : unsigned int
+{
+	SHADER_LIGHTING = 1 << 0,
+	SHADER_TINT = 1 << 1,
+	SHADER_ANIMATED = 1 << 2
+};
+
+#define SHADER_FEATURE_COUNT 3
+
+extern const char* SHADER_FEATURE_NAMES[SHADER_FEATURE_COUNT];
+
+// One pair of shader files built with different sets of features switched on, looked up by a bitmask
+// of ShaderFeature. A variant is compiled the first time it's asked for, so draws only pay for the
+// features they use.
+//
+// Compiling needs the GL context. Asked for an unbuilt variant on a thread without it (the game thread
+// while the render thread is running), get() records the request and hands back the variant with every
+// supported feature on, which is built up front. The thread owning the context builds what was asked for
+// in buildRequested() before its next replay, so the full variant only stands in until then - for a
+// frame or two after the features change, which draws the same picture, just slower.
+class ShaderVariants
+{
+private:
+
+	std::string vertexFilename;
+	std::string fragmentFilename;
+
+	// Features the source actually has switches for - other bits are ignored, so they don't build duplicates
+	unsigned int supported;
+
+	// Guards programs, requested and builtCount - get() runs on the game thread, buildRequested() on the render thread
+	std::mutex mutex;
+
+	// Indexed by key, NULL until built
+	std::vector<ShaderProgram*> programs;
+
+	// Bit per key asked for without a context and not built yet
+	unsigned int requested;
+
+	int builtCount;
+
+	ShaderProgram* build(unsigned int key);
+
+public:
+	ShaderVariants(const std::string& vertexFilename, const std::string& fragmentFilename, unsigned int supported);
+	~ShaderVariants();
+
+	ShaderProgram* get(unsigned int features);
+
+	// Builds the variants get() couldn't - GL thread only. Returns true if it built any, since building
+	// changes the bound program behind any GLStateCache.
+	bool buildRequested();
+
+	int getVariantCount();
+
+	// The #define lines for a set of features
+	static std::string defines(unsigned int features);
+};
@@ -0,0 +1,669 @@
+#include "stdafx.h"
+
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+
+#include <intrin.h>
+
+static_assert(TILE_SIZE == MAP_TILE_DIM * 2, "Software tiles are magnified by exactly 2x");
+
+static bool detectAvx2()
+{
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+		return false;
+
+	// The OS has to save the YMM registers too, not just the CPU support them
+	__cpuid(info, 1);
+
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+}
+
+static std::uint32_t packColour(Colour colour)
+{
+	return ((std::uint32_t)(glm::clamp(colour.w, 0.0f, 1.0f) * 255.0f) << 24) |
+		((std::uint32_t)(glm::clamp(colour.b, 0.0f, 1.0f) * 255.0f) << 16) |
+		((std::uint32_t)(glm::clamp(colour.g, 0.0f, 1.0f) * 255.0f) << 8) |
+		(std::uint32_t)(glm::clamp(colour.r, 0.0f, 1.0f) * 255.0f);
+}
+
+static int wrap(int i, int n)
+{
+	return ((i % n) + n) % n;
+}
+
+// ---------- Span kernels ----------
+// Pixels are RGBA8 with red in the low byte. Blending is src * a + dst * (1 - a) on every channel like
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), and x / 255 is rounded as (x + 128 + ((x + 128) >> 8)) >> 8.
+
+static inline std::uint32_t blendPixel(std::uint32_t d, std::uint32_t s)
+{
+	std::uint32_t a = s >> 24;
+	std::uint32_t result = 0;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		std::uint32_t x = (((s >> shift) & 0xFF) * a) + (((d >> shift) & 0xFF) * (255 - a)) + 128;
+
+		result |= (((x + (x >> 8)) >> 8) & 0xFF) << shift;
+	}
+
+	return result;
+}
+
+static inline std::uint32_t modulatePixel(std::uint32_t p, std::uint32_t c)
+{
+	std::uint32_t result = 0;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		std::uint32_t x = (((p >> shift) & 0xFF) * ((c >> shift) & 0xFF)) + 128;
+
+		result |= (((x + (x >> 8)) >> 8) & 0xFF) << shift;
+	}
+
+	return result;
+}
+
+// Two pixels widened to 16 bits per channel
+static inline __m128i blendWide(__m128i d, __m128i s)
+{
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), a);
+
+	__m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, inverse)), _mm_set1_epi16(128));
+
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static void blendSSE2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+		__m128i low = blendWide(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+		__m128i high = blendWide(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(low, high));
+	}
+
+	for (; i < count; i++)
+		dst[i] = blendPixel(dst[i], src[i]);
+}
+
+static inline __m256i blendWideAVX2(__m256i d, __m256i s)
+{
+	__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+
+	__m256i x = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, inverse)), _mm256_set1_epi16(128));
+
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+static void blendAVX2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	int i = 0;
+
+	// Unpack and pack both work within 128-bit lanes, so the pixel order survives the round trip
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+		__m256i low = blendWideAVX2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+		__m256i high = blendWideAVX2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(low, high));
+	}
+
+	blendSSE2(dst + i, src + i, count - i);
+}
+
+static void copySSE2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+
+	for (; i < count; i++)
+		dst[i] = src[i];
+}
+
+static void copyAVX2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+
+	copySSE2(dst + i, src + i, count - i);
+}
+
+// Writes every source pixel twice, so dst takes 2 * count pixels
+static void magnifySSE2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+
+		_mm_storeu_si128((__m128i*)(dst + (i * 2)), _mm_unpacklo_epi32(s, s));
+		_mm_storeu_si128((__m128i*)(dst + (i * 2) + 4), _mm_unpackhi_epi32(s, s));
+	}
+
+	for (; i < count; i++)
+	{
+		dst[i * 2] = src[i];
+		dst[(i * 2) + 1] = src[i];
+	}
+}
+
+static void magnifyAVX2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	const __m256i low = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256i high = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+
+		_mm256_storeu_si256((__m256i*)(dst + (i * 2)), _mm256_permutevar8x32_epi32(s, low));
+		_mm256_storeu_si256((__m256i*)(dst + (i * 2) + 8), _mm256_permutevar8x32_epi32(s, high));
+	}
+
+	magnifySSE2(dst + (i * 2), src + i, count - i);
+}
+
+// Multiplies every pixel by an RGBA8 colour, like the tint in the tile and sprite shaders
+static void modulate(std::uint32_t* pixels, int count, std::uint32_t colour)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c = _mm_unpacklo_epi8(_mm_set1_epi32((int)colour), zero);
+	const __m128i bias = _mm_set1_epi16(128);
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), c), bias);
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), c), bias);
+
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+	}
+
+	for (; i < count; i++)
+		pixels[i] = modulatePixel(pixels[i], colour);
+}
+
+// ---------- Renderer ----------
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, int threads)
+{
+	this->width = width;
+	this->height = height;
+
+	pixels.resize(width * height);
+
+	// Same as the glClearColor() in initialise()
+	clearColour = packColour({ 0.4f, 0.0f, 1.0f, 1.0f });
+
+	avx2 = detectAvx2();
+
+	atlas = NULL;
+	atlasColumns = 1;
+	atlasFrames = 1;
+
+	animations = NULL;
+	time = 0.0f;
+
+	dungeon = NULL;
+	sprites = NULL;
+	spriteCount = 0;
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+
+	bandCount = std::max(1, std::min(std::min(threads, SOFTWARE_MAX_THREADS), height));
+
+	scratch.resize(bandCount, std::vector<std::uint32_t>(std::max(width, TILE_SIZE)));
+	layerScratch.resize(bandCount);
+
+	generation = 0;
+	pending = 0;
+	quitting = false;
+
+	// Band 0 is drawn by the calling thread
+	for (int i = 1; i < bandCount; i++)
+	{
+		workers.push_back(std::thread(&SoftwareRenderer::worker, this, i));
+	}
+
+	glGenTextures(1, &presentTexture);
+
+	glBindTexture(GL_TEXTURE_2D, presentTexture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &VAO);
+
+	shader = new ShaderProgram();
+
+	// Same attribute-less full-screen triangle as the tile map
+	shader->initFromFiles("./res/shaders/tilemap.vs", "./res/shaders/present.fs");
+
+	imageLocation = shader->addUniform<int>("image");
+
+#ifdef DEBUG_ON
+	printf("Software renderer: %d x %d, %d bands, %s\n", width, height, bandCount, avx2 ? "AVX2" : "SSE2");
+#endif
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		quitting = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread& t : workers)
+		t.join();
+
+	glDeleteTextures(1, &presentTexture);
+	glDeleteVertexArrays(1, &VAO);
+
+	delete shader;
+}
+
+void SoftwareRenderer::addTexture(unsigned int name, int width, int height, const unsigned char* rgba)
+{
+	SoftwareTexture& texture = textures[name];
+
+	texture.width = width;
+	texture.height = height;
+	texture.texels.resize(width * height);
+
+	memcpy(texture.texels.data(), rgba, texture.texels.size() * sizeof(std::uint32_t));
+}
+
+void SoftwareRenderer::setTileAtlas(unsigned int name, int columns, int frames)
+{
+	auto found = textures.find(name);
+
+	if (found == textures.end() || columns <= 0 || frames <= 0)
+	{
+		atlas = NULL;
+		return;
+	}
+
+	atlas = &found->second;
+	atlasColumns = columns;
+	atlasFrames = frames;
+
+	opaqueFrames.assign(frames, true);
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const std::uint32_t* texels = &atlas->texels[((frame / columns) * MAP_TILE_DIM * atlas->width) + ((frame % columns) * MAP_TILE_DIM)];
+
+		for (int y = 0; y < MAP_TILE_DIM && opaqueFrames[frame]; y++)
+		{
+			for (int x = 0; x < MAP_TILE_DIM; x++)
+			{
+				if ((texels[(y * atlas->width) + x] >> 24) != 0xFF)
+				{
+					opaqueFrames[frame] = false;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::blend(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	if (avx2)
+		blendAVX2(dst, src, count);
+	else
+		blendSSE2(dst, src, count);
+}
+
+void SoftwareRenderer::copy(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	if (avx2)
+		copyAVX2(dst, src, count);
+	else
+		copySSE2(dst, src, count);
+}
+
+void SoftwareRenderer::magnify(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+	if (avx2)
+		magnifyAVX2(dst, src, count);
+	else
+		magnifySSE2(dst, src, count);
+}
+
+void SoftwareRenderer::worker(int band)
+{
+	int seen = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			wake.wait(lock, [&] { return quitting || generation != seen; });
+
+			if (quitting)
+				return;
+
+			seen = generation;
+		}
+
+		renderBand(band, (band * height) / bandCount, ((band + 1) * height) / bandCount);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			pending--;
+		}
+
+		finished.notify_one();
+	}
+}
+
+void SoftwareRenderer::setAnimations(const TileAnimations* animations)
+{
+	this->animations = animations;
+}
+
+void SoftwareRenderer::render(Dungeon* dungeon, glm::vec2 camera, float time, SpriteBatch* sprites)
+{
+	this->dungeon = dungeon;
+	this->camera = camera;
+	this->time = time;
+	this->sprites = sprites;
+
+	spriteCount = sprites != NULL ? sprites->sortForDraw() : 0;
+
+	if (bandCount > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			pending = bandCount - 1;
+			generation++;
+		}
+
+		wake.notify_all();
+	}
+
+	renderBand(0, 0, height / bandCount);
+
+	if (bandCount > 1)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		finished.wait(lock, [this] { return pending == 0; });
+	}
+}
+
+void SoftwareRenderer::renderBand(int band, int y0, int y1)
+{
+	std::uint32_t* row = scratch[band].data();
+
+	for (int y = y0; y < y1; y++)
+	{
+		std::fill(pixels.begin() + (y * width), pixels.begin() + ((y + 1) * width), clearColour);
+	}
+
+	bool tiles = dungeon != NULL && atlas != NULL;
+
+	// Same order as the GL path
+	if (tiles)
+	{
+		drawTiles(row, y0, y1);
+		drawLayer(band, TileLayer::WALLS, y0, y1);
+		drawLayer(band, TileLayer::DECALS, y0, y1);
+	}
+
+	drawSprites(row, y0, y1);
+
+	if (tiles)
+		drawLayer(band, TileLayer::OVERHEAD, y0, y1);
+}
+
+void SoftwareRenderer::drawTiles(std::uint32_t* row, int y0, int y1)
+{
+	// World position of the bottom left corner of the screen - the camera sits in the centre, one pixel per unit
+	const float originX = camera.x - (width * 0.5f);
+	const float originY = camera.y - (height * 0.5f);
+
+	const float half = TILE_SIZE * 0.5f;
+
+	TileRange range = dungeon->getVisibleRange({ originX, originX + width, originY + y0, originY + y1 });
+
+	for (int ty = range.firstY; ty <= range.lastY; ty++)
+	{
+		for (int tx = range.firstX; tx <= range.lastX; tx++)
+		{
+			const Tile& t = dungeon->getTile(tx, ty);
+
+			// Pixels whose centres fall inside the tile, as the GL rasterises it
+			int left = (int)std::ceil((t.posX * TILE_SIZE) - half - originX - 0.5f);
+			int bottom = (int)std::ceil((t.posY * TILE_SIZE) - half - originY - 0.5f);
+
+			drawTile(row, left, bottom, t.id, packColour(t.colour), y0, y1);
+		}
+	}
+}
+
+void SoftwareRenderer::drawLayer(int band, TileLayer layer, int y0, int y1)
+{
+	const float originX = camera.x - (width * 0.5f);
+	const float originY = camera.y - (height * 0.5f);
+
+	const float half = TILE_SIZE * 0.5f;
+
+	// Just this band's rows
+	Box2d visible = { originX, originX + width, originY + y0, originY + y1 };
+
+	std::vector<LayerTile>& tiles = layerScratch[band];
+
+	tiles.clear();
+
+	dungeon->getVisibleLayerTiles(layer, visible, tiles);
+
+	for (const LayerTile& t : tiles)
+	{
+		int left = (int)std::ceil((t.posX * TILE_SIZE) - half - originX - 0.5f);
+		int bottom = (int)std::ceil((t.posY * TILE_SIZE) - half - originY - 0.5f);
+
+		drawTile(scratch[band].data(), left, bottom, t.id, 0xFFFFFFFFu, y0, y1);
+	}
+}
+
+void SoftwareRenderer::drawTile(std::uint32_t* row, int left, int bottom, unsigned int id, std::uint32_t tint, int y0, int y1)
+{
+	// The first covered pixel always starts a texel pair, so rows magnify the same way wherever the camera is
+	int clipLeft = std::max(left, 0);
+	int clipRight = std::min(left + TILE_SIZE, width);
+	int rowStart = std::max(bottom, y0);
+	int rowEnd = std::min(bottom + TILE_SIZE, y1);
+
+	if (clipLeft >= clipRight || rowStart >= rowEnd)
+		return;
+
+	int frame = id % atlasFrames;
+
+	if (animations != NULL)
+		frame = animations->resolve(frame, time) % atlasFrames;
+
+	const std::uint32_t* texels = &atlas->texels[((frame / atlasColumns) * MAP_TILE_DIM * atlas->width) + ((frame % atlasColumns) * MAP_TILE_DIM)];
+
+	bool opaque = opaqueFrames[frame] && (tint >> 24) == 0xFF;
+
+	int magnifiedRow = -1;
+
+	for (int y = rowStart; y < rowEnd; y++)
+	{
+		int texelRow = (y - bottom) / 2;
+
+		// Each magnified texel row covers two screen rows
+		if (texelRow != magnifiedRow)
+		{
+			magnify(row, texels + (texelRow * atlas->width), MAP_TILE_DIM);
+
+			if (tint != 0xFFFFFFFFu)
+				modulate(row, TILE_SIZE, tint);
+
+			magnifiedRow = texelRow;
+		}
+
+		std::uint32_t* dst = &pixels[(y * width) + clipLeft];
+
+		if (opaque)
+			copy(dst, row + (clipLeft - left), clipRight - clipLeft);
+		else
+			blend(dst, row + (clipLeft - left), clipRight - clipLeft);
+	}
+}
+
+void SoftwareRenderer::drawSprites(std::uint32_t* row, int y0, int y1)
+{
+	const float originX = camera.x - (width * 0.5f);
+	const float originY = camera.y - (height * 0.5f);
+
+	unsigned int lastName = 0;
+	const SoftwareTexture* texture = NULL;
+
+	for (size_t i = 0; i < spriteCount; i++)
+	{
+		const SpriteCommand& s = sprites->getSorted(i);
+
+		// Sprites come sorted by texture, so the lookup rarely changes
+		if (texture == NULL || s.texture != lastName)
+		{
+			auto found = textures.find(s.texture);
+
+			lastName = s.texture;
+			texture = found != textures.end() ? &found->second : NULL;
+		}
+
+		if (texture == NULL)
+			continue;
+
+		float left = s.position.x - (s.size.x * 0.5f) - originX;
+		float bottom = s.position.y - (s.size.y * 0.5f) - originY;
+
+		int x0 = std::max((int)std::ceil(left - 0.5f), 0);
+		int x1 = std::min((int)std::ceil(left + s.size.x - 0.5f), width);
+		int rowStart = std::max((int)std::ceil(bottom - 0.5f), y0);
+		int rowEnd = std::min((int)std::ceil(bottom + s.size.y - 0.5f), y1);
+
+		if (x0 >= x1 || rowStart >= rowEnd)
+			continue;
+
+		// Texels per pixel - sampled at pixel centres, nearest texel, repeating like the GL texture
+		float du = (s.texRect.z - s.texRect.x) * texture->width / s.size.x;
+		float dv = (s.texRect.w - s.texRect.y) * texture->height / s.size.y;
+
+		float u0 = (s.texRect.x * texture->width) + ((x0 + 0.5f - left) * du);
+
+		for (int y = rowStart; y < rowEnd; y++)
+		{
+			float v = (s.texRect.y * texture->height) + ((y + 0.5f - bottom) * dv);
+
+			const std::uint32_t* texels = &texture->texels[wrap((int)std::floor(v), texture->height) * texture->width];
+
+			for (int x = x0; x < x1; x++)
+			{
+				row[x - x0] = texels[wrap((int)std::floor(u0 + ((x - x0) * du)), texture->width)];
+			}
+
+			if (s.colour != 0xFFFFFFFFu)
+				modulate(row, x1 - x0, s.colour);
+
+			blend(&pixels[(y * width) + x0], row, x1 - x0);
+		}
+	}
+}
+
+void SoftwareRenderer::present(RenderCommandList* commands)
+{
+	commands->texSubImage2D(GL_TEXTURE_2D, presentTexture, 0, 0, width, height,
+		GL_RGBA, GL_UNSIGNED_BYTE, sizeof(std::uint32_t), width, pixels.data());
+
+	// The frame is already blended, it just replaces what's there
+	commands->blend(false, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	commands->useProgram(shader->getId());
+
+	commands->setUniform(imageLocation, 0);
+
+	commands->bindTexture(0, GL_TEXTURE_2D, presentTexture);
+
+	commands->bindVertexArray(VAO);
+
+	commands->drawArrays(GL_TRIANGLES, 0, 3);
+
+	// Back to the blending the frame started with, for the minimap and anything else drawn over it
+	commands->blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+const unsigned char* SoftwareRenderer::getPixels()
+{
+	return (const unsigned char*)pixels.data();
+}
+
+int SoftwareRenderer::getThreadCount()
+{
+	return bandCount;
+}
+
+bool SoftwareRenderer::usesAvx2()
+{
+	return avx2;
+}
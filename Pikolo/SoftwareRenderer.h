@@ -0,0 +1,130 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+#include "SpriteBatch.h"
+#include "TileAnimations.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Most bands a frame is split into
+#define SOFTWARE_MAX_THREADS 16
+
+// A decoded RGBA8 image, rows bottom-up like the GL copy
+struct SoftwareTexture {
+
+	int width;
+	int height;
+
+	std::vector<std::uint32_t> texels;
+};
+
+// Draws the visible tiles and the sprite batch on the CPU into an RGBA8 framebuffer, using SSE2 (or AVX2
+// when the CPU has it) for the row copies, 2x tile magnification and alpha blending. The frame can be
+// split into horizontal bands drawn on worker threads. The result is shown by uploading it to a texture
+// and drawing one full-screen triangle, so the GL only has to present it.
+class SoftwareRenderer
+{
+private:
+
+	int width;
+	int height;
+
+	std::vector<std::uint32_t> pixels;
+
+	std::uint32_t clearColour;
+
+	bool avx2;
+
+	// Decoded copies of the loaded textures, keyed by GL name so sprites can be looked up by their texture
+	std::map<unsigned int, SoftwareTexture> textures;
+
+	const SoftwareTexture* atlas;
+	int atlasColumns;
+	int atlasFrames;
+
+	// Atlas frames with no transparent texels can be copied rather than blended
+	std::vector<bool> opaqueFrames;
+
+	const TileAnimations* animations;
+
+	// This frame's inputs, read by every band
+	Dungeon* dungeon;
+	glm::vec2 camera;
+	float time;
+	SpriteBatch* sprites;
+	size_t spriteCount;
+
+	int bandCount;
+
+	// Per band scratch rows and culled layer cells, so bands never share memory they write
+	std::vector<std::vector<std::uint32_t>> scratch;
+	std::vector<std::vector<LayerTile>> layerScratch;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	// Bumped once per frame to release the workers, which count pending back down to zero
+	int generation;
+	int pending;
+	bool quitting;
+
+	unsigned int presentTexture;
+	unsigned int VAO;
+
+	ShaderProgram* shader;
+	Uniform<int> imageLocation;
+
+	void worker(int band);
+
+	// Draw rows [y0, y1) of the frame
+	void renderBand(int band, int y0, int y1);
+
+	void drawTiles(std::uint32_t* row, int y0, int y1);
+	void drawLayer(int band, TileLayer layer, int y0, int y1);
+
+	// One tile with its bottom left pixel at (left, bottom), clipped to rows [y0, y1)
+	void drawTile(std::uint32_t* row, int left, int bottom, unsigned int id, std::uint32_t tint, int y0, int y1);
+	void drawSprites(std::uint32_t* row, int y0, int y1);
+
+	void blend(std::uint32_t* dst, const std::uint32_t* src, int count);
+	void copy(std::uint32_t* dst, const std::uint32_t* src, int count);
+	void magnify(std::uint32_t* dst, const std::uint32_t* src, int count);
+
+	SoftwareRenderer() {}
+
+public:
+	// threads = 0 uses one band per hardware thread
+	SoftwareRenderer(int width, int height, int threads);
+	~SoftwareRenderer();
+
+	// Keep a copy of a texture loaded for the GL, so sprites using it can be drawn
+	void addTexture(unsigned int name, int width, int height, const unsigned char* rgba);
+
+	// The tile atlas is a grid of MAP_TILE_DIM frames, columns wide
+	void setTileAtlas(unsigned int name, int columns, int frames);
+
+	// Animated frames are resolved through the same table as the GL path - NULL draws every tile still
+	void setAnimations(const TileAnimations* animations);
+
+	// Draw the dungeon's layers around camera at time (seconds) and every sprite queued in the batch, overhead layer last
+	void render(Dungeon* dungeon, glm::vec2 camera, float time, SpriteBatch* sprites);
+
+	// Record the upload and full-screen draw showing the last rendered frame - leaves alpha blending on, as render() set it
+	void present(RenderCommandList* commands);
+
+	// RGBA8, bottom row first
+	const unsigned char* getPixels();
+
+	int getThreadCount();
+	bool usesAvx2();
+};
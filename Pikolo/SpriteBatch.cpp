@@ -0,0 +1,271 @@
+#include "stdafx.h"
+
+#include "SpriteBatch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+SpriteBatch::SpriteBatch(StreamBuffer* stream)
+{
+	defaultProgram = new ShaderProgram();
+
+	defaultProgram->initFromFiles("./res/shaders/sprite.vs", "./res/shaders/sprite.fs");
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &EBO);
+
+	glBindVertexArray(VAO);
+
+	// Attributes point at the start of the ring - each flush selects its allocation with a base vertex
+	glBindBuffer(GL_ARRAY_BUFFER, stream->getBuffer());
+
+	// The quad pattern never changes, so every index is written once up front
+	std::vector<unsigned short> indices(MAX_BATCH_SPRITES * 6);
+
+	for (int i = 0; i < MAX_BATCH_SPRITES; i++)
+	{
+		unsigned short v = (unsigned short)(i * 4);
+
+		indices[(i * 6) + 0] = v + 0;
+		indices[(i * 6) + 1] = v + 1;
+		indices[(i * 6) + 2] = v + 3;
+		indices[(i * 6) + 3] = v + 1;
+		indices[(i * 6) + 4] = v + 2;
+		indices[(i * 6) + 5] = v + 3;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+
+	// position attribute
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, position));
+	glEnableVertexAttribArray(0);
+	// texture coord attribute
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, texCoord));
+	glEnableVertexAttribArray(1);
+	// colour attribute
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, colour));
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	programs.push_back(defaultProgram);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	glDeleteBuffers(1, &EBO);
+	glDeleteVertexArrays(1, &VAO);
+
+	delete defaultProgram;
+}
+
+std::uint64_t SpriteBatch::makeKey(int layer, int program, int texture, float depth)
+{
+	// Flip the float bits so that unsigned comparison orders them like floats
+	std::uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+
+	return ((std::uint64_t)(layer & 0xFF) << 56) |
+		((std::uint64_t)(program & 0xFF) << 48) |
+		((std::uint64_t)(texture & 0xFFFF) << 32) |
+		(std::uint64_t)bits;
+}
+
+int SpriteBatch::programSlot(ShaderProgram* program)
+{
+	for (size_t i = 0; i < programs.size(); i++)
+	{
+		if (programs[i] == program)
+			return (int)i;
+	}
+
+	programs.push_back(program);
+
+	return (int)programs.size() - 1;
+}
+
+int SpriteBatch::textureSlot(unsigned int texture)
+{
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i] == texture)
+			return (int)i;
+	}
+
+	textures.push_back(texture);
+
+	return (int)textures.size() - 1;
+}
+
+void SpriteBatch::begin()
+{
+	sprites.clear();
+}
+
+void SpriteBatch::draw(unsigned int texture, glm::vec2 position, glm::vec2 size, glm::vec4 texRect, Colour colour,
+	int layer, float depth, ShaderProgram* program)
+{
+	if (program == NULL)
+		program = defaultProgram;
+
+	SpriteCommand s;
+
+	s.key = makeKey(layer, programSlot(program), textureSlot(texture), depth);
+	s.position = position;
+	s.size = size;
+	s.texRect = texRect;
+	s.colour = ((std::uint32_t)(glm::clamp(colour.w, 0.0f, 1.0f) * 255.0f) << 24) |
+		((std::uint32_t)(glm::clamp(colour.b, 0.0f, 1.0f) * 255.0f) << 16) |
+		((std::uint32_t)(glm::clamp(colour.g, 0.0f, 1.0f) * 255.0f) << 8) |
+		(std::uint32_t)(glm::clamp(colour.r, 0.0f, 1.0f) * 255.0f);
+	s.texture = texture;
+	s.program = program;
+
+	sprites.push_back(s);
+}
+
+// LSD radix sort on the 64-bit key, 8 bits per pass. Stable, so sprites with equal keys keep
+// submission order, and passes where every key shares the same byte are skipped.
+void SpriteBatch::sortSprites()
+{
+	size_t count = sprites.size();
+
+	sorted.resize(count);
+	scratch.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		sorted[i] = { sprites[i].key, (std::uint32_t)i };
+	}
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t buckets[256] = { 0 };
+
+		for (size_t i = 0; i < count; i++)
+		{
+			buckets[(sorted[i].key >> shift) & 0xFF]++;
+		}
+
+		if (buckets[(sorted[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+
+		for (int b = 0; b < 256; b++)
+		{
+			size_t n = buckets[b];
+			buckets[b] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			scratch[buckets[(sorted[i].key >> shift) & 0xFF]++] = sorted[i];
+		}
+
+		sorted.swap(scratch);
+	}
+}
+
+int SpriteBatch::drawBatches(RenderCommandList* commands, size_t first, size_t last)
+{
+	int draws = 0;
+
+	size_t batchStart = first;
+
+	for (size_t i = first; i < last; i++)
+	{
+		const SpriteCommand& s = sprites[sorted[i].index];
+
+		bool endOfBatch = (i + 1 == last);
+
+		if (!endOfBatch)
+		{
+			const SpriteCommand& next = sprites[sorted[i + 1].index];
+
+			endOfBatch = next.program != s.program || next.texture != s.texture;
+		}
+
+		if (!endOfBatch)
+			continue;
+
+		commands->useProgram(s.program->getId());
+
+		commands->bindTexture(0, GL_TEXTURE_2D, s.texture);
+
+		commands->drawStreamedElements(GL_TRIANGLES, (int)((i + 1 - batchStart) * 6), GL_UNSIGNED_SHORT,
+			(batchStart - first) * 6 * sizeof(unsigned short), 0);
+
+		draws++;
+
+		batchStart = i + 1;
+	}
+
+	return draws;
+}
+
+int SpriteBatch::end(RenderCommandList* commands)
+{
+	if (sprites.empty())
+		return 0;
+
+	sortSprites();
+
+	commands->bindVertexArray(VAO);
+
+	int draws = 0;
+
+	size_t first = 0;
+
+	while (first < sprites.size())
+	{
+		size_t last = std::min(first + MAX_BATCH_SPRITES, sprites.size());
+
+		// Copied into the stream buffer on replay - if the frame's budget runs out there, these draws are dropped
+		SpriteVertex* v = (SpriteVertex*)commands->streamVertices((last - first) * 4 * sizeof(SpriteVertex), sizeof(SpriteVertex));
+
+		for (size_t i = first; i < last; i++, v += 4)
+		{
+			const SpriteCommand& s = sprites[sorted[i].index];
+
+			glm::vec2 half = s.size * 0.5f;
+
+			// top right, bottom right, bottom left, top left - same winding as the tile quad
+			v[0] = { glm::vec2(s.position.x + half.x, s.position.y + half.y), glm::vec2(s.texRect.z, s.texRect.w), s.colour };
+			v[1] = { glm::vec2(s.position.x + half.x, s.position.y - half.y), glm::vec2(s.texRect.z, s.texRect.y), s.colour };
+			v[2] = { glm::vec2(s.position.x - half.x, s.position.y - half.y), glm::vec2(s.texRect.x, s.texRect.y), s.colour };
+			v[3] = { glm::vec2(s.position.x - half.x, s.position.y + half.y), glm::vec2(s.texRect.x, s.texRect.w), s.colour };
+		}
+
+		draws += drawBatches(commands, first, last);
+
+		first = last;
+	}
+
+	return draws;
+}
+
+size_t SpriteBatch::sortForDraw()
+{
+	if (!sprites.empty())
+		sortSprites();
+	else
+		sorted.clear();
+
+	return sorted.size();
+}
+
+const SpriteCommand& SpriteBatch::getSorted(size_t i)
+{
+	return sprites[sorted[i].index];
+}
+
+size_t SpriteBatch::getSpriteCount()
+{
+	return sprites.size();
+}
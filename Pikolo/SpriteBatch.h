@@ -0,0 +1,98 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+#include "StreamBuffer.h"
+
+#include <cstdint>
+
+// Most sprites a single flush can hold - 4 vertices each keeps the indices within an unsigned short
+#define MAX_BATCH_SPRITES 16384
+
+struct SpriteVertex {
+
+	glm::vec2 position;
+	glm::vec2 texCoord;
+
+	// RGBA8, normalised in the shader
+	std::uint32_t colour;
+};
+
+// A queued sprite - sorted by key before being turned into vertices
+struct SpriteCommand {
+
+	std::uint64_t key;
+
+	glm::vec2 position;
+	glm::vec2 size;
+
+	// u0, v0, u1, v1
+	glm::vec4 texRect;
+
+	std::uint32_t colour;
+
+	unsigned int texture;
+
+	ShaderProgram* program;
+};
+
+// Accumulates textured quads from any number of textures and programs, sorts them by
+// (layer, program, texture, depth) and flushes them in as few draws as possible
+class SpriteBatch
+{
+private:
+
+	struct SortEntry {
+		std::uint64_t key;
+		std::uint32_t index;
+	};
+
+	unsigned int VAO;
+	unsigned int EBO;
+
+	ShaderProgram* defaultProgram;
+
+	std::vector<SpriteCommand> sprites;
+
+	// Radix sort ping-pong buffers
+	std::vector<SortEntry> sorted;
+	std::vector<SortEntry> scratch;
+
+	// Small tables mapping GL names to the ids packed into sort keys
+	std::vector<ShaderProgram*> programs;
+	std::vector<unsigned int> textures;
+
+	int programSlot(ShaderProgram* program);
+	int textureSlot(unsigned int texture);
+
+	void sortSprites();
+
+	// Record a draw for every batch in [first, last), drawing from the vertices streamed just before
+	int drawBatches(RenderCommandList* commands, size_t first, size_t last);
+
+public:
+	// Vertices are streamed through the shared per-frame ring when the recorded list is replayed
+	SpriteBatch(StreamBuffer* stream);
+	~SpriteBatch();
+
+	static std::uint64_t makeKey(int layer, int program, int texture, float depth);
+
+	void begin();
+
+	// Queue a sprite centred on position. Higher layers draw on top, depth orders sprites within a layer.
+	// Custom programs get the camera from the Frame uniform block, like the default one.
+	void draw(unsigned int texture, glm::vec2 position, glm::vec2 size, glm::vec4 texRect, Colour colour,
+		int layer = 0, float depth = 0.0f, ShaderProgram* program = NULL);
+
+	// Sort and record everything queued since begin(), returns the number of draw calls recorded
+	int end(RenderCommandList* commands);
+
+	// Sort everything queued since begin() without recording it, for backends that draw the sprites themselves.
+	// Returns the sprite count - getSorted(i) then gives them in draw order.
+	size_t sortForDraw();
+	const SpriteCommand& getSorted(size_t i);
+
+	size_t getSpriteCount();
+};
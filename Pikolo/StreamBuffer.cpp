@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "StreamBuffer.h"
+
+#include <cstring>
+
+// GL_ARB_buffer_storage isn't part of our 3.3 core loader, so it's fetched by hand when the driver has it
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_ARB)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+StreamBuffer::StreamBuffer(GLenum target, size_t frameSize)
+{
+	this->target = target;
+	this->frameSize = frameSize;
+
+	mapped = NULL;
+
+	frameIndex = 0;
+	head = 0;
+
+	current = {};
+	last = {};
+
+	for (int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++)
+		fences[i] = 0;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	PFNGLBUFFERSTORAGEPROC_ARB bufferStorage = NULL;
+
+	if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+		bufferStorage = (PFNGLBUFFERSTORAGEPROC_ARB)glfwGetProcAddress("glBufferStorage");
+
+	persistent = bufferStorage != NULL;
+
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		bufferStorage(target, frameSize * STREAM_FRAMES_IN_FLIGHT, NULL, flags);
+
+		mapped = (unsigned char*)glMapBufferRange(target, 0, frameSize * STREAM_FRAMES_IN_FLIGHT, flags);
+
+		// Some drivers advertise the extension but refuse the mapping - start again without it
+		if (mapped == NULL)
+		{
+			persistent = false;
+
+			glBindBuffer(target, 0);
+			glDeleteBuffers(1, &buffer);
+
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+		}
+	}
+
+	if (!persistent)
+	{
+		glBufferData(target, frameSize, NULL, GL_STREAM_DRAW);
+
+		staging.resize(frameSize);
+	}
+
+	glBindBuffer(target, 0);
+
+#ifdef DEBUG_ON
+	printf("Stream buffer: %zu KB per frame, %s\n", frameSize / 1024, persistent ? "persistent mapping" : "orphaning");
+#endif
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	}
+
+	if (persistent)
+	{
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+
+	glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::beginFrame()
+{
+	head = 0;
+
+	if (persistent)
+	{
+		GLsync fence = fences[frameIndex];
+
+		if (fence)
+		{
+			// Poll first, so only real waits are counted as stalls
+			GLenum result = glClientWaitSync(fence, 0, 0);
+
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				double start = glfwGetTime();
+
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+
+				current.stalls++;
+				current.stallTime += glfwGetTime() - start;
+			}
+
+			glDeleteSync(fence);
+			fences[frameIndex] = 0;
+		}
+	}
+	else
+	{
+		// Hand the old storage to the driver, it frees it once the GPU is done with it
+		glBindBuffer(target, buffer);
+		glBufferData(target, frameSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(target, 0);
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	if (persistent)
+		fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	frameIndex = (frameIndex + 1) % STREAM_FRAMES_IN_FLIGHT;
+
+	current.bytesUploaded = head;
+
+	last = current;
+	current = {};
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+	// Offsets are aligned within the whole buffer, not just the region, since vertex strides needn't be powers of two
+	size_t regionStart = persistent ? frameIndex * frameSize : 0;
+
+	size_t offset = regionStart + head;
+
+	if (alignment > 1)
+		offset = ((offset + alignment - 1) / alignment) * alignment;
+
+	if (offset + size > regionStart + frameSize)
+	{
+		current.failedAllocations++;
+
+		return { NULL, 0, 0 };
+	}
+
+	head = offset + size - regionStart;
+
+	unsigned char* data = persistent ? mapped + offset : staging.data() + offset;
+
+	return { data, offset, size };
+}
+
+void StreamBuffer::flush(const StreamAllocation& allocation)
+{
+	if (persistent || allocation.data == NULL)
+		return;
+
+	glBindBuffer(target, buffer);
+	glBufferSubData(target, allocation.offset, allocation.size, allocation.data);
+	glBindBuffer(target, 0);
+}
+
+unsigned int StreamBuffer::getBuffer()
+{
+	return buffer;
+}
+
+bool StreamBuffer::isPersistent()
+{
+	return persistent;
+}
+
+StreamBufferStats StreamBuffer::getStats()
+{
+	return last;
+}
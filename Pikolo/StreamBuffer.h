@@ -0,0 +1,86 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Frames the CPU may run ahead of the GPU before allocations have to wait
+#define STREAM_FRAMES_IN_FLIGHT 3
+
+// A sub-allocation for the current frame. Write to data, then call StreamBuffer::flush() before drawing from offset.
+struct StreamAllocation {
+
+	unsigned char* data;
+
+	// Byte offset of data within the GL buffer
+	size_t offset;
+
+	size_t size;
+};
+
+struct StreamBufferStats {
+
+	// Bytes handed out during the last completed frame
+	size_t bytesUploaded;
+
+	// Times beginFrame() had to wait for the GPU to release a region, and how long it waited
+	int stalls;
+	double stallTime;
+
+	// Allocations that didn't fit in the frame's budget
+	int failedAllocations;
+};
+
+// Ring buffer for per-frame dynamic geometry. Each frame gets its own region, and a fence placed at the end
+// of the frame guards the region until the GPU has finished reading it. Uses a persistently mapped buffer
+// when GL_ARB_buffer_storage is available, otherwise orphans a single region each frame and uploads
+// allocations from a CPU staging copy.
+class StreamBuffer
+{
+private:
+
+	unsigned int buffer;
+
+	GLenum target;
+
+	// Bytes available to each frame
+	size_t frameSize;
+
+	bool persistent;
+
+	// Persistent: base of the whole mapped ring. Fallback: CPU staging for one frame.
+	unsigned char* mapped;
+	std::vector<unsigned char> staging;
+
+	GLsync fences[STREAM_FRAMES_IN_FLIGHT];
+
+	int frameIndex;
+
+	// Bytes used in the current frame's region
+	size_t head;
+
+	StreamBufferStats current;
+	StreamBufferStats last;
+
+	StreamBuffer() {}
+
+public:
+	StreamBuffer(GLenum target, size_t frameSize);
+	~StreamBuffer();
+
+	// Waits for the GPU to release this frame's region (persistent) or orphans the buffer (fallback)
+	void beginFrame();
+
+	// Fences this frame's region and rotates to the next one
+	void endFrame();
+
+	// Returns an allocation with data == NULL if the frame's budget is exhausted
+	StreamAllocation allocate(size_t size, size_t alignment);
+
+	// Makes the written allocation visible to the GL - a no-op for coherent persistent mappings
+	void flush(const StreamAllocation& allocation);
+
+	unsigned int getBuffer();
+
+	bool isPersistent();
+
+	StreamBufferStats getStats();
+};
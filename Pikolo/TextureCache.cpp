@@ -0,0 +1,264 @@
+#include "stdafx.h"
+
+#include "TextureCache.h"
+
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::experimental::filesystem;
+
+MappedFile::MappedFile()
+{
+	view = NULL;
+	length = 0;
+
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping != NULL)
+		view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	file = ::open(path.c_str(), O_RDONLY);
+
+	if (file < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)info.st_size;
+
+	void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+
+	if (mapped != MAP_FAILED)
+		view = (const unsigned char*)mapped;
+#endif
+
+	if (view == NULL)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (view != NULL)
+		UnmapViewOfFile(view);
+
+	if (mapping != NULL)
+		CloseHandle(mapping);
+
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (view != NULL)
+		munmap((void*)view, length);
+
+	if (file >= 0)
+		::close(file);
+
+	file = -1;
+#endif
+
+	view = NULL;
+	length = 0;
+}
+
+const unsigned char* MappedFile::data()
+{
+	return view;
+}
+
+size_t MappedFile::size()
+{
+	return length;
+}
+
+TextureCache::TextureCache(const std::string& directory)
+{
+	this->directory = directory;
+}
+
+std::string TextureCache::entryPrefix(const std::string& source)
+{
+	std::string path = fs::path(source).generic_string();
+
+	char name[16];
+	sprintf_s(name, "-%08x-", (unsigned int)fnv1a(path.data(), path.size()));
+
+	return fs::path(source).stem().string() + name;
+}
+
+std::string TextureCache::entryPath(const std::string& source, std::uint64_t hash)
+{
+	char name[32];
+	sprintf_s(name, "%016llx.mip", (unsigned long long)hash);
+
+	return (fs::path(directory) / (entryPrefix(source) + name)).string();
+}
+
+bool TextureCache::load(const std::string& source, std::uint64_t hash, MappedFile& file, TextureCacheHeader& header)
+{
+	if (!file.open(entryPath(source, hash)) || file.size() < sizeof(TextureCacheHeader))
+		return false;
+
+	memcpy(&header, file.data(), sizeof(TextureCacheHeader));
+
+	bool valid = memcmp(header.magic, "PKTX", 4) == 0 && header.version == TEXTURE_CACHE_VERSION && header.sourceHash == hash &&
+		header.width > 0 && header.height > 0 && header.levels == levelCount(header.width, header.height) &&
+		file.size() == sizeof(TextureCacheHeader) + levelOffset(header.width, header.height, header.levels);
+
+	// A truncated or foreign file is rebuilt like a missing one
+	if (!valid)
+		file.close();
+
+	return valid;
+}
+
+bool TextureCache::store(const std::string& source, std::uint64_t hash, int width, int height, int levels, const std::vector<unsigned char>& chain)
+{
+	std::error_code error;
+
+	fs::create_directories(directory, error);
+
+	// Only one entry per source is ever useful
+	std::string prefix = entryPrefix(source);
+
+	for (auto& entry : fs::directory_iterator(directory, error))
+	{
+		std::string name = entry.path().filename().string();
+
+		if (name.size() == prefix.size() + 20 && name.compare(0, prefix.size(), prefix) == 0)
+			fs::remove(entry.path(), error);
+	}
+
+	TextureCacheHeader header = {};
+
+	memcpy(header.magic, "PKTX", 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = hash;
+	header.width = width;
+	header.height = height;
+	header.levels = levels;
+
+	return writeFileAtomically(entryPath(source, hash), &header, sizeof(header), chain.data(), chain.size());
+}
+
+int TextureCache::levelCount(int width, int height)
+{
+	int levels = 1;
+
+	while (width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+
+		levels++;
+	}
+
+	return levels;
+}
+
+size_t TextureCache::levelOffset(int width, int height, int level)
+{
+	size_t offset = 0;
+
+	for (int i = 0; i < level; i++)
+	{
+		offset += (size_t)width * height * 4;
+
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	return offset;
+}
+
+void TextureCache::buildMipChain(std::vector<unsigned char>& chain, int width, int height)
+{
+	int levels = levelCount(width, height);
+
+	chain.resize(levelOffset(width, height, levels));
+
+	for (int level = 1; level < levels; level++)
+	{
+		const unsigned char* src = &chain[levelOffset(width, height, level - 1)];
+		unsigned char* dst = &chain[levelOffset(width, height, level)];
+
+		int srcWidth = std::max(width >> (level - 1), 1);
+		int srcHeight = std::max(height >> (level - 1), 1);
+		int dstWidth = std::max(srcWidth / 2, 1);
+		int dstHeight = std::max(srcHeight / 2, 1);
+
+		for (int y = 0; y < dstHeight; y++)
+		{
+			// A side that's already 1 texel just repeats it
+			const unsigned char* row0 = &src[(size_t)std::min(y * 2, srcHeight - 1) * srcWidth * 4];
+			const unsigned char* row1 = &src[(size_t)std::min((y * 2) + 1, srcHeight - 1) * srcWidth * 4];
+
+			for (int x = 0; x < dstWidth; x++)
+			{
+				int x0 = std::min(x * 2, srcWidth - 1) * 4;
+				int x1 = std::min((x * 2) + 1, srcWidth - 1) * 4;
+
+				for (int c = 0; c < 4; c++)
+					dst[(((size_t)y * dstWidth) + x) * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+}
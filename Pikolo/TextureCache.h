@@ -0,0 +1,88 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CacheFile.h"
+
+#include <cstdint>
+#include <string>
+
+// Bumped whenever the layout of a cache entry changes, so stale entries are rebuilt
+#define TEXTURE_CACHE_VERSION 1
+
+// Start of every cache entry, followed by the mip levels back to back, largest first. Each level is
+// RGBA8 with the bottom row first, ready to hand to glTexImage2D.
+struct TextureCacheHeader {
+
+	char magic[4];
+	std::uint32_t version;
+
+	// Hash of the source file's bytes - an entry for older contents is ignored
+	std::uint64_t sourceHash;
+
+	std::int32_t width;
+	std::int32_t height;
+	std::int32_t levels;
+	std::int32_t padding;
+};
+
+// A read-only view of a whole file, paged in by the OS as it's touched
+class MappedFile
+{
+private:
+
+	const unsigned char* view;
+	size_t length;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data();
+	size_t size();
+};
+
+// Decoded textures with their mip chains, stored next to the resources and keyed by a hash of the
+// source PNG. A hit skips decoding and mipmap generation - the entry is mapped and uploaded as it is.
+class TextureCache
+{
+private:
+
+	std::string directory;
+
+	// Entries are named after the source file, a hash of its path and a hash of its contents, e.g.
+	// map_x-89abcdef-0123456789abcdef.mip - the path hash keeps same-named files in different folders apart
+	std::string entryPath(const std::string& source, std::uint64_t hash);
+
+	// The part of an entry's name that only depends on the source's path
+	static std::string entryPrefix(const std::string& source);
+
+public:
+	TextureCache(const std::string& directory);
+
+	// Maps the entry for these contents of source - false if there isn't a valid one
+	bool load(const std::string& source, std::uint64_t hash, MappedFile& file, TextureCacheHeader& header);
+
+	// Writes an entry for the chain, removing any left over from older contents of the same file
+	bool store(const std::string& source, std::uint64_t hash, int width, int height, int levels, const std::vector<unsigned char>& chain);
+
+	// Levels in a full chain down to 1 x 1, and where each starts in it
+	static int levelCount(int width, int height);
+	static size_t levelOffset(int width, int height, int level);
+
+	// Appends every level below the first to the chain, each box-filtered from the one above
+	static void buildMipChain(std::vector<unsigned char>& chain, int width, int height);
+};
@@ -0,0 +1,402 @@
+#include "stdafx.h"
+
+#include "TextureUploader.h"
+
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+TextureUploader::TextureUploader(TextureCache* cache)
+{
+	this->cache = cache;
+
+	quitting = false;
+
+	// Rows bottom-up, as the GL expects them
+	stbi_set_flip_vertically_on_load(true);
+
+	worker = std::thread(&TextureUploader::work, this);
+}
+
+TextureUploader::~TextureUploader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		quitting = true;
+	}
+
+	wake.notify_all();
+
+	if (worker.joinable())
+		worker.join();
+
+	for (AsyncTexture* texture : textures)
+	{
+		if (texture->mapped != NULL)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		if (texture->pbo != 0)
+			glDeleteBuffers(1, &texture->pbo);
+
+		if (texture->fence != NULL)
+			glDeleteSync(texture->fence);
+
+		delete texture;
+	}
+}
+
+AsyncTexture* TextureUploader::load(const std::string& path, bool keepPixels)
+{
+	AsyncTexture* texture = new AsyncTexture();
+
+	texture->path = path;
+	texture->texture = 0;
+	texture->width = 0;
+	texture->height = 0;
+	texture->data = NULL;
+	texture->levels = 0;
+	texture->cached = false;
+	texture->ready = false;
+	texture->failed = false;
+	texture->state = TextureUploadState::QUEUED;
+	texture->keepPixels = keepPixels;
+	texture->chainSize = 0;
+	texture->pbo = 0;
+	texture->mapped = NULL;
+	texture->fence = NULL;
+	texture->decodeTime = 0.0;
+	texture->queuedAt = glfwGetTime();
+	texture->totalTime = 0.0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	textures.push_back(texture);
+
+	return texture;
+}
+
+void TextureUploader::queueWork(AsyncTexture* texture, TextureUploadState state)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		texture->state = state;
+		workQueue.push_back(texture);
+	}
+
+	wake.notify_all();
+}
+
+void TextureUploader::work()
+{
+	while (true)
+	{
+		AsyncTexture* texture;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			wake.wait(lock, [this] { return quitting || !workQueue.empty(); });
+
+			if (quitting)
+				return;
+
+			texture = workQueue.front();
+			workQueue.pop_front();
+		}
+
+		TextureUploadState next;
+
+		if (texture->state == TextureUploadState::DECODING)
+		{
+			decode(texture);
+			next = TextureUploadState::DECODED;
+		}
+		else
+		{
+			fill(texture);
+			next = TextureUploadState::FILLED;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			texture->state = next;
+		}
+
+		decoded.notify_all();
+	}
+}
+
+void TextureUploader::decode(AsyncTexture* texture)
+{
+	double start = glfwGetTime();
+
+	std::ifstream file(texture->path, std::ios::binary);
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (bytes.empty())
+	{
+		texture->failed = true;
+		return;
+	}
+
+	std::uint64_t hash = fnv1a(bytes.data(), bytes.size());
+
+	TextureCacheHeader header;
+
+	if (cache != NULL && cache->load(texture->path, hash, texture->cacheFile, header))
+	{
+		// Straight from the mapping - pages are read in as the copy into the pixel buffer touches them
+		texture->width = header.width;
+		texture->height = header.height;
+		texture->levels = header.levels;
+		texture->data = texture->cacheFile.data() + sizeof(TextureCacheHeader);
+		texture->cached = true;
+	}
+	else
+	{
+		int width, height, channels;
+		unsigned char* pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 4);
+
+		if (pixels == NULL)
+		{
+			texture->failed = true;
+			return;
+		}
+
+		texture->chain.assign(pixels, pixels + ((size_t)width * height * 4));
+
+		stbi_image_free(pixels);
+
+		TextureCache::buildMipChain(texture->chain, width, height);
+
+		texture->width = width;
+		texture->height = height;
+		texture->levels = TextureCache::levelCount(width, height);
+		texture->data = texture->chain.data();
+
+		if (cache != NULL && !cache->store(texture->path, hash, width, height, texture->levels, texture->chain))
+			printf("Couldn't write the texture cache entry for %s\n", texture->path.c_str());
+	}
+
+	texture->chainSize = TextureCache::levelOffset(texture->width, texture->height, texture->levels);
+
+	texture->decodeTime = glfwGetTime() - start;
+}
+
+void TextureUploader::fill(AsyncTexture* texture)
+{
+	memcpy(texture->mapped, texture->data, texture->chainSize);
+}
+
+bool TextureUploader::beginUpload(AsyncTexture* texture)
+{
+	glGenBuffers(1, &texture->pbo);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, texture->chainSize, NULL, GL_STREAM_DRAW);
+
+	// Not persistent, so it has to be unmapped before the upload - the worker is done with it by then
+	texture->mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, texture->chainSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Without a mapping the levels are uploaded from the CPU copy instead
+	if (texture->mapped != NULL)
+		queueWork(texture, TextureUploadState::FILLING);
+	else
+		texture->state = TextureUploadState::FILLED;
+
+	return true;
+}
+
+bool TextureUploader::finishUpload(AsyncTexture* texture)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo);
+
+	bool fromBuffer = texture->mapped != NULL;
+
+	// The store can be lost while mapped (e.g. a mode switch), in which case the texels are gone
+	if (fromBuffer && !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+		texture->failed = true;
+
+	texture->mapped = NULL;
+
+	if (!fromBuffer)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!texture->failed)
+	{
+		glGenTextures(1, &texture->texture);
+
+		glBindTexture(GL_TEXTURE_2D, texture->texture);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levels - 1);
+
+		// The chain is already built, so there's no glGenerateMipmap. With a pixel unpack buffer bound the
+		// pointer is an offset into it.
+		for (int level = 0; level < texture->levels; level++)
+		{
+			size_t offset = TextureCache::levelOffset(texture->width, texture->height, level);
+
+			const void* pixels = fromBuffer ? (const void*)offset : (const void*)(texture->data + offset);
+
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(texture->width >> level, 1), std::max(texture->height >> level, 1), 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		texture->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	texture->state = TextureUploadState::UPLOADING;
+
+	return true;
+}
+
+void TextureUploader::release(AsyncTexture* texture)
+{
+	texture->data = NULL;
+
+	std::vector<unsigned char>().swap(texture->chain);
+
+	texture->cacheFile.close();
+}
+
+bool TextureUploader::poll()
+{
+	bool called = false;
+
+	std::vector<AsyncTexture*> inFlight;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (AsyncTexture* texture : textures)
+		{
+			if (!texture->ready)
+				inFlight.push_back(texture);
+		}
+	}
+
+	for (AsyncTexture* texture : inFlight)
+	{
+		switch (texture->state)
+		{
+		case TextureUploadState::QUEUED:
+			queueWork(texture, TextureUploadState::DECODING);
+			break;
+
+		case TextureUploadState::DECODED:
+			if (!texture->failed)
+			{
+				called |= beginUpload(texture);
+				break;
+			}
+
+			// Nothing to upload
+			texture->state = TextureUploadState::UPLOADING;
+			break;
+
+		case TextureUploadState::FILLED:
+			called |= finishUpload(texture);
+			break;
+
+		case TextureUploadState::UPLOADING:
+		{
+			// Never blocks - a fence that hasn't signalled is looked at again next poll
+			if (texture->fence != NULL)
+			{
+				GLenum result = glClientWaitSync(texture->fence, 0, 0);
+
+				called = true;
+
+				if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED && result != GL_WAIT_FAILED)
+					break;
+
+				glDeleteSync(texture->fence);
+				texture->fence = NULL;
+			}
+
+			if (texture->pbo != 0)
+			{
+				glDeleteBuffers(1, &texture->pbo);
+				texture->pbo = 0;
+
+				called = true;
+			}
+
+			if (!texture->keepPixels || texture->failed)
+				release(texture);
+
+			texture->totalTime = glfwGetTime() - texture->queuedAt;
+			texture->state = TextureUploadState::DONE;
+			texture->ready = true;
+
+#ifdef DEBUG_ON
+			if (texture->failed)
+				printf("FAILED TO LOAD TEXTURE %s\n", texture->path.c_str());
+			else
+				printf("Loaded %s (%d x %d, %d levels) - %s in %.2f ms, ready after %.2f ms\n", texture->path.c_str(), texture->width, texture->height,
+					texture->levels, texture->cached ? "mapped from the cache" : "decoded", 1000.0 * texture->decodeTime, 1000.0 * texture->totalTime);
+#endif
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	return called;
+}
+
+void TextureUploader::finish()
+{
+	while (getPendingCount() > 0)
+	{
+		poll();
+
+		// Woken as soon as the worker has something for the next poll, otherwise waiting on the GPU's fences
+		std::unique_lock<std::mutex> lock(mutex);
+
+		decoded.wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
+
+void TextureUploader::releasePixels(AsyncTexture* texture)
+{
+	if (texture->ready)
+		release(texture);
+}
+
+int TextureUploader::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	int pending = 0;
+
+	for (AsyncTexture* texture : textures)
+	{
+		if (!texture->ready)
+			pending++;
+	}
+
+	return pending;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "TextureCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Where a texture is in the pipeline - DECODING and FILLING run on the worker, the rest on the GL thread in poll()
+enum class TextureUploadState
+{
+	QUEUED, DECODING, DECODED, FILLING, FILLED, UPLOADING, DONE
+};
+
+// A texture being loaded in the background. Owned by the TextureUploader, and only usable once ready.
+struct AsyncTexture {
+
+	std::string path;
+
+	// GL name and size, valid once ready
+	unsigned int texture;
+	int width;
+	int height;
+
+	// Level 0 of the mip chain, RGBA with the bottom row first - still valid once ready only when asked for at load()
+	const unsigned char* data;
+
+	int levels;
+
+	// Came from the cache rather than being decoded
+	bool cached;
+
+	// Set on the GL thread once the upload has finished on the GPU, or the file couldn't be loaded
+	std::atomic<bool> ready;
+	bool failed;
+
+	// The uploader's bookkeeping. The chain is either decoded into chain or read from the mapped cache entry.
+	std::atomic<TextureUploadState> state;
+	bool keepPixels;
+	std::vector<unsigned char> chain;
+	MappedFile cacheFile;
+	size_t chainSize;
+	unsigned int pbo;
+	unsigned char* mapped;
+	GLsync fence;
+
+	// Seconds spent decoding on the worker, and from load() to ready
+	double decodeTime;
+	double queuedAt;
+	double totalTime;
+};
+
+// Loads textures without blocking the GL thread. A worker hashes each PNG and maps its cache entry, or
+// decodes it and builds the mip chain and cache entry on a miss. The GL thread then maps a pixel buffer
+// for the chain, the worker copies it in, and the GL thread uploads every level from the buffer and
+// fences the upload - the texture reports ready once the fence has signalled. poll() must be called on
+// whichever thread owns the context: by hand during startup, and by the render thread once it has started.
+class TextureUploader
+{
+private:
+
+	std::vector<AsyncTexture*> textures;
+
+	// NULL decodes every time
+	TextureCache* cache;
+
+	// Textures waiting for the worker, and the worker's
+	std::deque<AsyncTexture*> workQueue;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	// Signalled whenever the worker finishes one, for finish()
+	std::condition_variable decoded;
+
+	bool quitting;
+
+	void work();
+
+	// Worker steps
+	void decode(AsyncTexture* texture);
+	void fill(AsyncTexture* texture);
+
+	// GL thread steps - both return true if they made any GL calls
+	bool beginUpload(AsyncTexture* texture);
+	bool finishUpload(AsyncTexture* texture);
+
+	void queueWork(AsyncTexture* texture, TextureUploadState state);
+	void release(AsyncTexture* texture);
+
+public:
+	// cache may be NULL
+	TextureUploader(TextureCache* cache);
+	~TextureUploader();
+
+	// Queues a PNG for loading - can be called from any thread. keepPixels holds on to the decoded copy for
+	// code that needs the texels on the CPU as well.
+	AsyncTexture* load(const std::string& path, bool keepPixels);
+
+	// Advances every texture in flight without waiting. Returns true if it made any GL calls, so
+	// callers shadowing GL state know to drop it.
+	bool poll();
+
+	// Polls until every queued texture is ready - GL thread only
+	void finish();
+
+	// Frees or unmaps the CPU copy of a ready texture
+	void releasePixels(AsyncTexture* texture);
+
+	int getPendingCount();
+};
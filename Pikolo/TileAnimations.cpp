@@ -0,0 +1,124 @@
+#include "stdafx.h"
+
+#include "TileAnimations.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+TileAnimations::TileAnimations()
+{
+	animationCount = 0;
+
+	glGenBuffers(1, &buffer);
+
+	// The buffer needs storage before it can back a texture - build() replaces it
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::uvec4), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+TileAnimations::~TileAnimations()
+{
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &buffer);
+}
+
+void TileAnimations::build(const std::vector<TileAnimation>& animations, int totalFrames)
+{
+	table.resize(std::max(totalFrames, 1));
+
+	for (int i = 0; i < (int)table.size(); i++)
+		table[i] = glm::uvec4(i, 1, 1, 0);
+
+	animationCount = 0;
+
+	for (const TileAnimation& a : animations)
+	{
+		if (a.count < 2 || a.start + a.count > table.size())
+		{
+#ifdef DEBUG_ON
+			printf("Skipping animation of %u frames from %u - the atlas has %d frames\n", a.count, a.start, totalFrames);
+#endif
+			continue;
+		}
+
+		unsigned int milliseconds = std::max((unsigned int)(a.frameDuration * 1000.0f), 1u);
+
+		table[a.start] = glm::uvec4(a.start, a.count, milliseconds, 0);
+
+		animationCount++;
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(glm::uvec4), table.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+#ifdef DEBUG_ON
+	printf("Loaded %d tile animations...\n", animationCount);
+#endif
+}
+
+void TileAnimations::loadFromFile(const std::string& path, int totalFrames)
+{
+	std::vector<TileAnimation> animations;
+
+	std::ifstream file(path);
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		TileAnimation a;
+
+		if (fields >> a.start >> a.count >> a.frameDuration)
+			animations.push_back(a);
+	}
+
+	build(animations, totalFrames);
+}
+
+void TileAnimations::bind(RenderCommandList* commands)
+{
+	commands->bindTexture(ANIMATION_UNIT, GL_TEXTURE_BUFFER, texture);
+}
+
+unsigned int TileAnimations::resolve(unsigned int frame, float time) const
+{
+	if (frame >= table.size() || table[frame].y < 2)
+		return frame;
+
+	const glm::uvec4& a = table[frame];
+
+	return a.x + ((unsigned int)(time * 1000.0f) / a.z) % a.y;
+}
+
+bool TileAnimations::isAnimated(unsigned int frame) const
+{
+	return frame < table.size() && table[frame].y >= 2;
+}
+
+float TileAnimations::timeToNextFrame(unsigned int frame, float time) const
+{
+	if (!isAnimated(frame))
+		return 0.0f;
+
+	// Same millisecond clock as resolve()
+	unsigned int now = (unsigned int)(time * 1000.0f);
+	unsigned int step = table[frame].z;
+
+	return (float)(((now / step) + 1) * step - now) / 1000.0f;
+}
+
+int TileAnimations::getAnimationCount()
+{
+	return animationCount;
+}
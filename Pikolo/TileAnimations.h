@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RenderCommandList.h"
+
+#include <string>
+
+// A run of consecutive atlas frames played in a loop
+struct TileAnimation {
+
+	unsigned int start;
+	unsigned int count;
+
+	// Seconds each frame is shown for
+	float frameDuration;
+};
+
+// Animations keyed by atlas frame - any tile or layer cell set to an animation's first frame plays it. The
+// table has an entry per frame and lives in a buffer texture read by animation.glsl, which picks the
+// current frame from the Frame block's time, so animated tiles need no CPU work or re-uploads.
+class TileAnimations
+{
+private:
+
+	unsigned int buffer;
+	unsigned int texture;
+
+	// Per atlas frame: first frame, frame count, milliseconds per frame, unused. Frames that don't start an
+	// animation have a count of 1.
+	std::vector<glm::uvec4> table;
+
+	int animationCount;
+
+public:
+	TileAnimations();
+	~TileAnimations();
+
+	// Fills and uploads the table - frames past totalFrames are dropped
+	void build(const std::vector<TileAnimation>& animations, int totalFrames);
+
+	// Builds from a file of "start count seconds" lines, # starting a comment. A missing file leaves every tile still.
+	void loadFromFile(const std::string& path, int totalFrames);
+
+	// Record binding the table to ANIMATION_UNIT
+	void bind(RenderCommandList* commands);
+
+	// Frame shown at the given time, as animation.glsl works it out
+	unsigned int resolve(unsigned int frame, float time) const;
+
+	// Whether the frame starts an animation
+	bool isAnimated(unsigned int frame) const;
+
+	// Seconds from the given time until an animated frame moves on to its next one
+	float timeToNextFrame(unsigned int frame, float time) const;
+
+	int getAnimationCount();
+};
@@ -0,0 +1,115 @@
+#include "stdafx.h"
+
+#include "TileMapRenderer.h"
+
+#include <algorithm>
+
+TileMapRenderer::TileMapRenderer()
+{
+	dungeon = NULL;
+
+	width = 0;
+	height = 0;
+
+	totalFrames = 1;
+
+	shader = new ShaderProgram();
+
+	shader->initFromFiles("./res/shaders/tilemap.vs", "./res/shaders/tilemap.fs");
+
+	// The atlas stays on unit 0 and the tile map gets TILE_MAP_UNIT when the program links
+	mapSizeLocation = shader->addUniform<glm::vec2>("mapSize");
+
+	glGenVertexArrays(1, &VAO);
+
+	glGenTextures(1, &tileMapTexture);
+
+	glBindTexture(GL_TEXTURE_2D, tileMapTexture);
+
+	// Integer textures can't be filtered
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TileMapRenderer::~TileMapRenderer()
+{
+	glDeleteTextures(1, &tileMapTexture);
+	glDeleteVertexArrays(1, &VAO);
+
+	delete shader;
+}
+
+void TileMapRenderer::build(Dungeon* dungeon, int totalFrames)
+{
+	this->dungeon = dungeon;
+	this->totalFrames = totalFrames > 0 ? totalFrames : 1;
+
+	width = dungeon->getWidth();
+	height = dungeon->getHeight();
+
+	frames.resize(width * height);
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			frames[(y * width) + x] = (unsigned short)(dungeon->getTile(x, y).id % this->totalFrames);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, tileMapTexture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, frames.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifdef DEBUG_ON
+	printf("Uploaded %d x %d tile map texture...\n", width, height);
+#endif
+}
+
+void TileMapRenderer::update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed)
+{
+	if (dungeon == NULL || changed.empty())
+		return;
+
+	glm::ivec2 low(width, height);
+	glm::ivec2 high(-1, -1);
+
+	for (glm::ivec2 t : changed)
+	{
+		frames[(t.y * width) + t.x] = (unsigned short)(dungeon->getTile(t.x, t.y).id % totalFrames);
+
+		low = glm::ivec2(std::min(low.x, t.x), std::min(low.y, t.y));
+		high = glm::ivec2(std::max(high.x, t.x), std::max(high.y, t.y));
+	}
+
+	// The list packs just the rectangle out of the CPU copy, skipping the columns outside it
+	commands->texSubImage2D(GL_TEXTURE_2D, tileMapTexture, low.x, low.y, high.x - low.x + 1, high.y - low.y + 1,
+		GL_RED_INTEGER, GL_UNSIGNED_SHORT, sizeof(unsigned short), width, &frames[(low.y * width) + low.x]);
+}
+
+int TileMapRenderer::render(RenderCommandList* commands, unsigned int tileArray)
+{
+	if (dungeon == NULL)
+		return 0;
+
+	commands->useProgram(shader->getId());
+
+	commands->setUniform(mapSizeLocation, glm::vec2((float)width, (float)height));
+
+	commands->bindTexture(0, GL_TEXTURE_2D_ARRAY, tileArray);
+	commands->bindTexture(TILE_MAP_UNIT, GL_TEXTURE_2D, tileMapTexture);
+
+	commands->bindVertexArray(VAO);
+
+	commands->drawArrays(GL_TRIANGLES, 0, 3);
+
+	return 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderProgram.h"
+
+// Draws the whole visible map in one full-screen pass. The dungeon's tile ids live in an
+// integer texture and the fragment shader resolves every pixel to its atlas texel, so the
+// cost is constant per pixel regardless of tile count.
+class TileMapRenderer
+{
+private:
+
+	// Attribute-less VAO for the full-screen triangle
+	unsigned int VAO;
+
+	unsigned int tileMapTexture;
+
+	ShaderProgram* shader;
+
+	Uniform<glm::vec2> mapSizeLocation;
+
+	Dungeon* dungeon;
+
+	int width;
+	int height;
+
+	int totalFrames;
+
+	// CPU copy of the tile map texture, used as the source for sub-rectangle updates
+	std::vector<unsigned short> frames;
+
+public:
+	TileMapRenderer();
+	~TileMapRenderer();
+
+	// Upload the full tile id grid - call again after regenerating the dungeon
+	void build(Dungeon* dungeon, int totalFrames);
+
+	// Push the given tile edits as a single sub-rectangle update
+	void update(RenderCommandList* commands, const std::vector<glm::ivec2>& changed);
+
+	// Returns the number of draw calls recorded
+	int render(RenderCommandList* commands, unsigned int tileArray);
+};
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+
+#include "TileRenderer.h"
+
+#include <cstddef>
+
+TileRenderer::TileRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders)
+{
+	capacity = 0;
+
+	this->shaders = shaders;
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &instanceVBO);
+
+	glBindVertexArray(VAO);
+
+	// Same quad as the per-tile path
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+
+	// position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// texture coord attribute
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	setupInstanceAttributes(instanceVBO);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+TileRenderer::~TileRenderer()
+{
+	glDeleteBuffers(1, &instanceVBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+void TileRenderer::setTiles(RenderCommandList* commands, const std::vector<Tile>& tiles, int totalFrames)
+{
+	instances.clear();
+
+	for (const Tile& t : tiles)
+	{
+		instances.push_back({ glm::vec2((float)t.posX, (float)t.posY), t.id % totalFrames, t.colour });
+	}
+
+	if (instances.size() > capacity)
+	{
+		capacity = instances.size();
+
+		commands->bufferData(GL_ARRAY_BUFFER, instanceVBO, capacity * sizeof(TileInstance), instances.data(), GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		commands->bufferSubData(GL_ARRAY_BUFFER, instanceVBO, 0, instances.size() * sizeof(TileInstance), instances.data());
+	}
+}
+
+int TileRenderer::render(RenderCommandList* commands, unsigned int tileArray, unsigned int features)
+{
+	if (instances.empty())
+		return 0;
+
+	commands->useProgram(shaders->get(features)->getId());
+
+	commands->bindVertexArray(VAO);
+
+	commands->bindTexture(0, GL_TEXTURE_2D_ARRAY, tileArray);
+
+	commands->drawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, (int)instances.size());
+
+	return 1;
+}
+
+size_t TileRenderer::getInstanceCount()
+{
+	return instances.size();
+}
+
+void setupInstanceAttributes(unsigned int vbo)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	// tile position attribute (per instance)
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, position));
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+	// atlas frame attribute (per instance)
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(TileInstance), (void*)offsetof(TileInstance, frame));
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+	// tint attribute (per instance)
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, tint));
+	glEnableVertexAttribArray(4);
+	glVertexAttribDivisor(4, 1);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Dungeon.h"
+#include "RenderCommandList.h"
+#include "ShaderVariants.h"
+
+// Per-instance data streamed to the GPU, one entry per visible tile
+struct TileInstance {
+
+	glm::vec2 position;
+
+	unsigned int frame;
+
+	Colour tint;
+};
+
+// Binds vbo and points attributes 2-4 of the bound VAO at its TileInstance data, advancing once per instance
+void setupInstanceAttributes(unsigned int vbo);
+
+// Draws every visible tile with a single instanced call on top of the shared quad VBO/EBO
+class TileRenderer
+{
+private:
+
+	unsigned int VAO;
+	unsigned int instanceVBO;
+
+	// Number of instances the instance buffer currently has storage for
+	size_t capacity;
+
+	// Shared with the other instanced renderers
+	ShaderVariants* shaders;
+
+	std::vector<TileInstance> instances;
+
+	TileRenderer() {}
+
+public:
+	TileRenderer(unsigned int quadVBO, unsigned int quadEBO, ShaderVariants* shaders);
+	~TileRenderer();
+
+	// Rebuild the instance buffer - only needed when the visible set changes
+	void setTiles(RenderCommandList* commands, const std::vector<Tile>& tiles, int totalFrames);
+
+	// Draws with the variant for the ShaderFeature bits, returns the number of draw calls recorded
+	int render(RenderCommandList* commands, unsigned int tileArray, unsigned int features);
+
+	size_t getInstanceCount();
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// A uniform's location, resolved once by ShaderProgram::addUniform() and typed by the value it takes, so
+// setting it is a plain int copy and a value of the wrong type doesn't compile. -1 is ignored by the GL.
+// It remembers its program, so debug builds can catch it being set while another program is in use.
+template<typename T>
+struct Uniform {
+
+	unsigned int program;
+	int location;
+
+	Uniform() : program(0), location(-1) {}
+	Uniform(unsigned int program, int location) : program(program), location(location) {}
+};
@@ -28,6 +28,38 @@
 // width of tiles in .png file
 #define MAP_TILE_DIM 32
 
+// width of a single frame in sprite.png
+#define SPRITE_DIM 32
+
+// Sprites drawn per frame when the sprite stress test (F5) is on
+#define SPRITE_STRESS_COUNT 50000
+
+// Uniform block any program can declare to receive the per-frame camera data, and the binding point feeding it
+#define FRAME_UNIFORM_BLOCK "Frame"
+#define FRAME_UNIFORM_BINDING 0
+
+// Screen squares lights are culled into - keep in step with lighting.glsl
+#define LIGHT_TILE_SIZE 32
+
+// Buffer textures holding the culled lights, and the units every program reads them from
+#define LIGHT_SAMPLER_LIGHTS "lights"
+#define LIGHT_SAMPLER_GRID "lightGrid"
+#define LIGHT_SAMPLER_INDICES "lightIndices"
+#define LIGHT_UNIT_LIGHTS 1
+#define LIGHT_UNIT_GRID 2
+#define LIGHT_UNIT_INDICES 3
+
+// Buffer texture of tile animations, and the unit every program reads it from
+#define ANIMATION_SAMPLER "animations"
+#define ANIMATION_UNIT 4
+
+// The tile map renderer's per-cell frame texture - a unit of its own, since it's a different sampler type
+#define TILE_MAP_SAMPLER "tileMap"
+#define TILE_MAP_UNIT 5
+
+// Bytes of dynamic vertex data each frame may stream
+#define STREAM_BUFFER_FRAME_SIZE (8 * 1024 * 1024)
+
 // Minimum number of tiles per dimension in a room 
 #define MIN_ROOM_SIZE 3
 // Maximum number of tiles per dimension in a room 
@@ -35,6 +67,9 @@
 
 #define DEFAULT_ROOM_SIZE 16
 
+// Number of tiles per dimension in a render chunk
+#define CHUNK_SIZE 16
+
 // Minimum number of portals a room can have 
 #define MIN_CONNECTEDNESS 1
 // Maximum number of portals a room can have
@@ -55,9 +90,6 @@ const float SIZETILEY = (float)(TILE_SIZE) * HEIGHT1PX;
 
 const glm::vec3 scale = glm::vec3(WIDTH1PX, HEIGHT1PX, 0.0f);
 
-const int TILES_ON_SCREEN_X = (WIDTH / (TILE_SIZE * 2));
-const int TILES_ON_SCREEN_Y = (HEIGHT / (TILE_SIZE * 2));
-
 struct Box2d {
 	float left;
 	float right;